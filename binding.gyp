@@ -11,6 +11,7 @@
 				"./recastnavigation/DetourTileCache/Include",
 				"./recastnavigation/Recast/Include/",
 				"./recastnavigation/RecastDemo/Include/",
+				"./recastnavigation/RecastDemo/Contrib/fastlz",
 				"<!(node -e \"require('nan')\")"
 			],
 
@@ -47,7 +48,16 @@
 				"./recastnavigation/RecastDemo/Source/Sample.cpp",
 				"./recastnavigation/RecastDemo/Source/SampleInterfaces.cpp",
 
-				"./src/main.cc"
+				"./recastnavigation/RecastDemo/Contrib/fastlz/fastlz.c",
+
+				"./src/landmarks.cc",
+				"./src/main.cc",
+				"./src/navmesh.cc",
+				"./src/pathcache.cc",
+				"./src/portalgraph.cc",
+				"./src/querystats.cc",
+				"./src/randompoints.cc",
+				"./src/tileset.cc"
 			],
 		}
 	]
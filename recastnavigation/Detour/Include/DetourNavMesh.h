@@ -430,6 +430,11 @@ public:
 	/// @return The tile at the specified index.
 	const dtMeshTile* getTile(int i) const;
 
+	/// The number of off-mesh connections in the added tiles that can only be
+	/// taken from start to end. Their links only point along that direction.
+	/// @return The number of one-way off-mesh connections.
+	int getOneWayOffMeshConCount() const { return m_oneWayOffMeshConCount; }
+
 	/// Gets the tile and polygon for the specified polygon reference.
 	///  @param[in]		ref		The reference for the a polygon.
 	///  @param[out]	tile	The tile containing the polygon.
@@ -666,6 +671,7 @@ private:
 	dtMeshTile** m_posLookup;			///< Tile hash lookup.
 	dtMeshTile* m_nextFree;				///< Freelist of tiles.
 	dtMeshTile* m_tiles;				///< List of tiles.
+	int m_oneWayOffMeshConCount;		///< Number of off-mesh connections without #DT_OFFMESH_CON_BIDIR.
 		
 #ifndef DT_POLYREF64
 	unsigned int m_saltBits;			///< Number of salt bits in the tile ID.
@@ -20,6 +20,7 @@
 #define DETOURNAVMESHQUERY_H
 
 #include "DetourNavMesh.h"
+#include "DetourNode.h"
 #include "DetourStatus.h"
 
 
@@ -159,6 +160,19 @@ public:
 	virtual void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count) = 0;
 };
 
+/// Provides a lower bound on path costs, e.g. from precomputed landmark distances.
+/// Used by dtNavMeshQuery::findPath to tighten its heuristic.
+/// @ingroup detour
+class dtPathCostBound
+{
+public:
+	virtual ~dtPathCostBound() { }
+
+	/// Returns a lower bound on the cost of any path from a polygon to the end polygon, or zero if none is known.
+	/// FLT_MAX means the end polygon cannot be reached from the polygon, findPath then never enters it.
+	virtual float getLowerBound(dtPolyRef ref, dtPolyRef endRef) const = 0;
+};
+
 /// Provides the ability to perform pathfinding related queries against
 /// a navigation mesh.
 /// @ingroup detour
@@ -170,9 +184,10 @@ public:
 	
 	/// Initializes the query object.
 	///  @param[in]		nav			Pointer to the dtNavMesh object to use for all queries.
-	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value <= 65535]
+	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value <= #DT_MAX_NODES]
+	///  @param[in]		queueType	The open list implementation used by the searches.
 	/// @returns The status flags for the query.
-	dtStatus init(const dtNavMesh* nav, const int maxNodes);
+	dtStatus init(const dtNavMesh* nav, const int maxNodes, const dtNodeQueueType queueType = DT_NODE_QUEUE_BINARY_HEAP);
 	
 	/// @name Standard Pathfinding Functions
 	// /@{
@@ -192,6 +207,35 @@ public:
 					  const dtQueryFilter* filter,
 					  dtPolyRef* path, int* pathCount, const int maxPath) const;
 
+	/// Finds a path from the start polygon to the end polygon with a bidirectional A* search.
+	/// One search runs forward from the start and one backward from the end, each with its
+	/// own node pool and open list, until they meet. The result has the same format as findPath.
+	///  @param[in]		startRef	The refrence id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	dtStatus findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+								   const float* startPos, const float* endPos,
+								   const dtQueryFilter* filter,
+								   dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Calculates the cost of a polygon corridor the way findPath does.
+	///  @param[in]		startPos	A position within the first polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the last polygon. [(x, y, z)]
+	///  @param[in]		path		The polygon corridor. [(polyRef) * @p pathSize]
+	///  @param[in]		pathSize	The number of polygons in the @p path array.
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	cost		The cost of the corridor.
+	/// @returns The status flags for the query.
+	dtStatus getPathCost(const float* startPos, const float* endPos,
+						 const dtPolyRef* path, const int pathSize,
+						 const dtQueryFilter* filter, float* cost) const;
+
 	/// Finds the straight path from the start to the end position within the polygon corridor.
 	///  @param[in]		startPos			Path start position. [(x, y, z)]
 	///  @param[in]		endPos				Path end position. [(x, y, z)]
@@ -499,9 +543,29 @@ public:
 	/// @returns The node pool.
 	class dtNodePool* getNodePool() const { return m_nodePool; }
 	
+	/// Gets the open list queue.
+	/// @returns The open list queue.
+	class dtNodeQueue* getOpenList() const { return m_openList; }
+	
+	/// Gets the node pool of the backward search of findPathBidirectional.
+	/// @returns The node pool, or null before the first bidirectional search.
+	class dtNodePool* getBackNodePool() const { return m_backNodePool; }
+	
+	/// Gets the open list of the backward search of findPathBidirectional.
+	/// @returns The open list queue, or null before the first bidirectional search.
+	class dtNodeQueue* getBackOpenList() const { return m_backOpenList; }
+	
 	/// Gets the navigation mesh the query object is using.
 	/// @return The navigation mesh the query object is using.
 	const dtNavMesh* getAttachedNavMesh() const { return m_nav; }
+	
+	/// Sets the lower bound findPath combines with its straight line heuristic.
+	///  @param[in]		bound	The bound to use, or null for none. It is not owned by the query.
+	void setPathCostBound(const dtPathCostBound* bound) { m_costBound = bound; }
+	
+	/// Gets the lower bound findPath combines with its straight line heuristic.
+	/// @returns The bound, or null if there is none.
+	const dtPathCostBound* getPathCostBound() const { return m_costBound; }
 
 	/// @}
 	
@@ -539,6 +603,15 @@ private:
 
 	// Gets the path leading to the specified end node.
 	dtStatus getPathToNode(struct dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const;
+
+	// Allocates the node pool and open list of the backward search to match the forward ones.
+	dtStatus allocBackSearch() const;
+	
+	// Frees the node pool and open list of the backward search.
+	void freeBackSearch() const;
+	
+	// Finds the one-way off-mesh connections that may end in the specified tile.
+	int getOneWayOffMeshConsAround(const dtMeshTile* tile, dtPolyRef* refs, const int maxRefs) const;
 	
 	const dtNavMesh* m_nav;				///< Pointer to navmesh data.
 
@@ -558,6 +631,9 @@ private:
 	class dtNodePool* m_tinyNodePool;	///< Pointer to small node pool.
 	class dtNodePool* m_nodePool;		///< Pointer to node pool.
 	class dtNodeQueue* m_openList;		///< Pointer to open list queue.
+	mutable class dtNodePool* m_backNodePool;	///< Pointer to node pool of the backward search, allocated on first use.
+	mutable class dtNodeQueue* m_backOpenList;	///< Pointer to open list queue of the backward search, allocated on first use.
+	const dtPathCostBound* m_costBound;	///< Optional lower bound for the findPath heuristic.
 };
 
 /// Allocates a query object using the Detour allocator.
@@ -28,27 +28,46 @@ enum dtNodeFlags
 	DT_NODE_PARENT_DETACHED = 0x04, // parent of the node is not adjacent. Found using raycast.
 };
 
-typedef unsigned short dtNodeIndex;
+typedef unsigned int dtNodeIndex;
 static const dtNodeIndex DT_NULL_IDX = (dtNodeIndex)~0;
 
 static const int DT_NODE_PARENT_BITS = 24;
 static const int DT_NODE_STATE_BITS = 2;
+
+/// The largest number of nodes a dtNodePool can hold. pidx is special as 0 means
+/// "none" and 1 is the first node, so one value of the parent bits is unusable.
+static const int DT_MAX_NODES = (1 << DT_NODE_PARENT_BITS) - 1;
+
+// The fields read when a node is looked up or popped come first, the position
+// only once the node is expanded.
 struct dtNode
 {
-	float pos[3];								///< Position of the node.
 	float cost;									///< Cost from previous node to current node.
 	float total;								///< Cost up to the node.
 	unsigned int pidx : DT_NODE_PARENT_BITS;	///< Index to parent node.
 	unsigned int state : DT_NODE_STATE_BITS;	///< extra state information. A polyRef can have multiple nodes with different extra info. see DT_MAX_STATES_PER_NODE
 	unsigned int flags : 3;						///< Node flags. A combination of dtNodeFlags.
 	dtPolyRef id;								///< Polygon ref the node corresponds to.
+	float pos[3];								///< Position of the node.
 };
 
 static const int DT_MAX_STATES_PER_NODE = 1 << DT_NODE_STATE_BITS;	// number of extra states per node. See dtNode::state
 
+/// A slot of the node pool's hash table. The key is stored next to the node
+/// index so lookups compare refs without touching the nodes.
+struct dtNodeSlot
+{
+	dtPolyRef id;		///< Polygon ref of the node.
+	unsigned int data;	///< Node index + 1 in the low DT_NODE_PARENT_BITS, the node state above. 0 when empty.
+};
+
+/// Nodes of a search, looked up by polygon ref and state in an open addressed
+/// hash table with linear probing.
 class dtNodePool
 {
 public:
+	/// @p hashSize is the number of hash slots, a power of two larger than
+	/// @p maxNodes. Twice the number of nodes keeps the probes short.
 	dtNodePool(int maxNodes, int hashSize);
 	~dtNodePool();
 	void clear();
@@ -82,41 +101,74 @@ public:
 		return sizeof(*this) +
 			sizeof(dtNode)*m_maxNodes +
 			sizeof(dtNodeIndex)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_hashSize;
+			sizeof(dtNodeSlot)*m_hashSize;
 	}
 	
 	inline int getMaxNodes() const { return m_maxNodes; }
 	
 	inline int getHashSize() const { return m_hashSize; }
-	inline dtNodeIndex getFirst(int bucket) const { return m_first[bucket]; }
-	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
+	/// Nodes are allocated in order, getNodeAtIdx(1) to getNodeAtIdx(getNodeCount()) are in use.
 	inline int getNodeCount() const { return m_nodeCount; }
 	
+	/// Number of nodes allocated since the pool was created. Unlike getNodeCount()
+	/// it is not reset by clear(), so callers can diff it around several searches.
+	inline unsigned int getAllocCount() const { return m_allocCount; }
+	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtNodePool(const dtNodePool&);
 	dtNodePool& operator=(const dtNodePool&);
 	
 	dtNode* m_nodes;
-	dtNodeIndex* m_first;
-	dtNodeIndex* m_next;
+	dtNodeSlot* m_hash;
+	dtNodeIndex* m_slots;	///< Hash slot of each node, so clear() only empties the slots in use.
 	const int m_maxNodes;
 	const int m_hashSize;
 	int m_nodeCount;
+	unsigned int m_allocCount;
+};
+
+/// Open list implementations, see dtNavMeshQuery::init.
+enum dtNodeQueueType
+{
+	DT_NODE_QUEUE_BINARY_HEAP = 0,		///< Binary heap of node pointers.
+	DT_NODE_QUEUE_QUATERNARY_HEAP = 1,	///< 4-ary heap of (total, node index) pairs, knows where each node is.
+};
+
+/// An entry of the 4-ary heap, the key is stored inline so sifting never
+/// touches the nodes.
+struct dtNodeQueueEntry
+{
+	float total;
+	unsigned int idx;	///< Index of the node in the pool, see dtNodePool::getNodeIdx.
 };
 
 class dtNodeQueue
 {
 public:
-	dtNodeQueue(int n);
+	/// The 4-ary heap only holds nodes of @p pool.
+	dtNodeQueue(int n, dtNodeQueueType type = DT_NODE_QUEUE_BINARY_HEAP, dtNodePool* pool = 0);
 	~dtNodeQueue();
 	
 	inline void clear() { m_size = 0; }
 	
-	inline dtNode* top() { return m_heap[0]; }
+	inline dtNode* top()
+	{
+		if (m_type == DT_NODE_QUEUE_QUATERNARY_HEAP)
+			return m_pool->getNodeAtIdx(m_entries[0].idx);
+		return m_heap[0];
+	}
 	
 	inline dtNode* pop()
 	{
+		if (m_type == DT_NODE_QUEUE_QUATERNARY_HEAP)
+		{
+			dtNode* result = m_pool->getNodeAtIdx(m_entries[0].idx);
+			m_size--;
+			if (m_size > 0)
+				trickleDownEntry(0, m_entries[m_size]);
+			return result;
+		}
 		dtNode* result = m_heap[0];
 		m_size--;
 		trickleDown(0, m_heap[m_size]);
@@ -125,12 +177,30 @@ public:
 	
 	inline void push(dtNode* node)
 	{
+		m_pushCount++;
 		m_size++;
+		if (m_type == DT_NODE_QUEUE_QUATERNARY_HEAP)
+		{
+			dtNodeQueueEntry entry;
+			entry.total = node->total;
+			entry.idx = m_pool->getNodeIdx(node);
+			bubbleUpEntry(m_size-1, entry);
+			return;
+		}
 		bubbleUp(m_size-1, node);
 	}
 	
+	/// Moves a node whose total decreased toward the top.
 	inline void modify(dtNode* node)
 	{
+		if (m_type == DT_NODE_QUEUE_QUATERNARY_HEAP)
+		{
+			dtNodeQueueEntry entry;
+			entry.total = node->total;
+			entry.idx = m_pool->getNodeIdx(node);
+			bubbleUpEntry(m_positions[entry.idx], entry);
+			return;
+		}
 		for (int i = 0; i < m_size; ++i)
 		{
 			if (m_heap[i] == node)
@@ -145,23 +215,45 @@ public:
 	
 	inline int getMemUsed() const
 	{
+		if (m_type == DT_NODE_QUEUE_QUATERNARY_HEAP)
+		{
+			return sizeof(*this) +
+			sizeof(dtNodeQueueEntry) * (m_capacity + 3) + DT_NODE_QUEUE_ALIGNMENT +
+			sizeof(int) * (m_pool->getMaxNodes() + 1);
+		}
 		return sizeof(*this) +
 		sizeof(dtNode*) * (m_capacity + 1);
 	}
 	
 	inline int getCapacity() const { return m_capacity; }
 	
+	inline dtNodeQueueType getType() const { return m_type; }
+	
+	/// Number of push() calls since the queue was created, not reset by clear().
+	inline unsigned int getPushCount() const { return m_pushCount; }
+	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtNodeQueue(const dtNodeQueue&);
 	dtNodeQueue& operator=(const dtNodeQueue&);
 
+	// Children of an entry share one cache line of the 4-ary heap.
+	static const int DT_NODE_QUEUE_ALIGNMENT = 4 * sizeof(dtNodeQueueEntry);
+
 	void bubbleUp(int i, dtNode* node);
 	void trickleDown(int i, dtNode* node);
+	void bubbleUpEntry(int i, dtNodeQueueEntry entry);
+	void trickleDownEntry(int i, dtNodeQueueEntry entry);
 	
 	dtNode** m_heap;
+	void* m_entryData;
+	dtNodeQueueEntry* m_entries;	///< Heap of the 4-ary queue, the children of i are 4i+1 to 4i+4.
+	int* m_positions;				///< Heap position of each node index of the 4-ary queue.
+	dtNodePool* m_pool;
+	const dtNodeQueueType m_type;
 	const int m_capacity;
 	int m_size;
+	unsigned int m_pushCount;
 };		
 
 
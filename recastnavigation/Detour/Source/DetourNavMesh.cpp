@@ -134,6 +134,17 @@ inline void freeLink(dtMeshTile* tile, unsigned int link)
 	tile->linksFreeList = link;
 }
 
+static int countOneWayOffMeshCons(const dtMeshTile* tile)
+{
+	int count = 0;
+	for (int i = 0; i < tile->header->offMeshConCount; ++i)
+	{
+		if (!(tile->offMeshCons[i].flags & DT_OFFMESH_CON_BIDIR))
+			count++;
+	}
+	return count;
+}
+
 
 dtNavMesh* dtAllocNavMesh()
 {
@@ -193,7 +204,8 @@ dtNavMesh::dtNavMesh() :
 	m_tileLutMask(0),
 	m_posLookup(0),
 	m_nextFree(0),
-	m_tiles(0)
+	m_tiles(0),
+	m_oneWayOffMeshConCount(0)
 {
 #ifndef DT_POLYREF64
 	m_saltBits = 0;
@@ -1009,6 +1021,7 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	// Base off-mesh connections to their starting polygons and connect connections inside the tile.
 	baseOffMeshLinks(tile);
 	connectExtOffMeshLinks(tile, tile, -1);
+	m_oneWayOffMeshConCount += countOneWayOffMeshCons(tile);
 
 	// Create connections with neighbour tiles.
 	static const int MAX_NEIS = 32;
@@ -1260,6 +1273,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 		cur = cur->next;
 	}
 	
+	m_oneWayOffMeshConCount -= countOneWayOffMeshCons(tile);
+	
 	// Remove connections to neighbour tiles.
 	static const int MAX_NEIS = 32;
 	dtMeshTile* neis[MAX_NEIS];
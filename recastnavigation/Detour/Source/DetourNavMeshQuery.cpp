@@ -139,7 +139,10 @@ dtNavMeshQuery::dtNavMeshQuery() :
 	m_nav(0),
 	m_tinyNodePool(0),
 	m_nodePool(0),
-	m_openList(0)
+	m_openList(0),
+	m_backNodePool(0),
+	m_backOpenList(0),
+	m_costBound(0)
 {
 	memset(&m_query, 0, sizeof(dtQueryData));
 }
@@ -155,6 +158,7 @@ dtNavMeshQuery::~dtNavMeshQuery()
 	dtFree(m_tinyNodePool);
 	dtFree(m_nodePool);
 	dtFree(m_openList);
+	freeBackSearch();
 }
 
 /// @par 
@@ -163,9 +167,9 @@ dtNavMeshQuery::~dtNavMeshQuery()
 /// functions are used.
 ///
 /// This function can be used multiple times.
-dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
+dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, const dtNodeQueueType queueType)
 {
-	if (maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
+	if (maxNodes < 1 || maxNodes > DT_MAX_NODES)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
 	m_nav = nav;
@@ -178,7 +182,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 			dtFree(m_nodePool);
 			m_nodePool = 0;
 		}
-		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes*2));
 		if (!m_nodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -189,7 +193,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 	
 	if (!m_tinyNodePool)
 	{
-		m_tinyNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(64, 32);
+		m_tinyNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(64, 128);
 		if (!m_tinyNodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -198,7 +202,9 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 		m_tinyNodePool->clear();
 	}
 	
-	if (!m_openList || m_openList->getCapacity() < maxNodes)
+	// A pool that grew is always paired with a new open list here, as the
+	// capacity of the list never exceeds the size of the pool.
+	if (!m_openList || m_openList->getCapacity() < maxNodes || m_openList->getType() != queueType)
 	{
 		if (m_openList)
 		{
@@ -206,7 +212,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 			dtFree(m_openList);
 			m_openList = 0;
 		}
-		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes);
+		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes, queueType, m_nodePool);
 		if (!m_openList)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -215,6 +221,14 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 		m_openList->clear();
 	}
 	
+	// findPathBidirectional allocates the backward search on first use, most
+	// queries never need it. Drop it when it no longer matches.
+	if ((m_backNodePool && m_backNodePool->getMaxNodes() < maxNodes) ||
+		(m_backOpenList && (m_backOpenList->getCapacity() < maxNodes || m_backOpenList->getType() != queueType)))
+	{
+		freeBackSearch();
+	}
+	
 	return DT_SUCCESS;
 }
 
@@ -943,6 +957,9 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 /// The start and end positions are used to calculate traversal costs. 
 /// (The y-values impact the result.)
 ///
+/// With a cost bound set by setPathCostBound, the heuristic is the larger of
+/// the straight line distance and the bound.
+///
 dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 								  const float* startPos, const float* endPos,
 								  const dtQueryFilter* filter,
@@ -981,12 +998,14 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 	startNode->pidx = 0;
 	startNode->cost = 0;
 	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
+	if (m_costBound)
+		startNode->total = dtMax(startNode->total, m_costBound->getLowerBound(startRef, endRef) * H_SCALE);
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_OPEN;
 	m_openList->push(startNode);
 	
 	dtNode* lastBestNode = startNode;
-	float lastBestNodeCost = startNode->total;
+	float lastBestNodeCost = dtVdist(startPos, endPos) * H_SCALE;
 	
 	bool outOfNodes = false;
 	
@@ -1037,6 +1056,15 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
 				continue;
 
+			// A polygon the end cannot be reached from has an infinite bound.
+			float bound = 0;
+			if (m_costBound && neighbourRef != endRef)
+			{
+				bound = m_costBound->getLowerBound(neighbourRef, endRef);
+				if (bound >= FLT_MAX)
+					continue;
+			}
+
 			// deal explicitly with crossing tile boundaries
 			unsigned char crossSide = 0;
 			if (bestTile->links[i].side != 0xff)
@@ -1061,6 +1089,7 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 			// Calculate cost and heuristic.
 			float cost = 0;
 			float heuristic = 0;
+			float estimate = 0;
 			
 			// Special case for last node.
 			if (neighbourRef == endRef)
@@ -1087,9 +1116,10 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 													  neighbourRef, neighbourTile, neighbourPoly);
 				cost = bestNode->cost + curCost;
 				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
+				estimate = dtMax(heuristic, bound*H_SCALE);
 			}
 
-			const float total = cost + heuristic;
+			const float total = cost + estimate;
 			
 			// The node is already in open list and the new result is worse, skip.
 			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
@@ -1177,6 +1207,486 @@ dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pa
 	return DT_SUCCESS;
 }
 
+dtStatus dtNavMeshQuery::allocBackSearch() const
+{
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+	
+	const int maxNodes = m_nodePool->getMaxNodes();
+	if (!m_backNodePool)
+	{
+		m_backNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes*2));
+		if (!m_backNodePool)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	if (!m_backOpenList)
+	{
+		m_backOpenList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes, m_openList->getType(), m_backNodePool);
+		if (!m_backOpenList)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	return DT_SUCCESS;
+}
+
+void dtNavMeshQuery::freeBackSearch() const
+{
+	// The open list refers to the pool, both go together.
+	if (m_backOpenList)
+		m_backOpenList->~dtNodeQueue();
+	if (m_backNodePool)
+		m_backNodePool->~dtNodePool();
+	dtFree(m_backOpenList);
+	dtFree(m_backNodePool);
+	m_backOpenList = 0;
+	m_backNodePool = 0;
+}
+
+/// @par
+///
+/// Detour links a one-way off-mesh connection to both of its ends, but only
+/// the polygon at its start links back to it. The polygon at its end has no
+/// link to the connection, so the connections that may end in a tile are
+/// found in the tiles around it, where Detour connects them.
+int dtNavMeshQuery::getOneWayOffMeshConsAround(const dtMeshTile* tile, dtPolyRef* refs, const int maxRefs) const
+{
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+	int n = 0;
+	for (int y = tile->header->y - 1; y <= tile->header->y + 1; ++y)
+	{
+		for (int x = tile->header->x - 1; x <= tile->header->x + 1; ++x)
+		{
+			const int nneis = m_nav->getTilesAt(x, y, neis, MAX_NEIS);
+			for (int j = 0; j < nneis; ++j)
+			{
+				const dtMeshTile* neiTile = neis[j];
+				for (int k = 0; k < neiTile->header->offMeshConCount && n < maxRefs; ++k)
+				{
+					const dtOffMeshConnection* con = &neiTile->offMeshCons[k];
+					if (!(con->flags & DT_OFFMESH_CON_BIDIR))
+						refs[n++] = m_nav->getPolyRefBase(neiTile) | (dtPolyRef)con->poly;
+				}
+			}
+		}
+	}
+	return n;
+}
+
+// Returns true if the off-mesh connection ends in the polygon.
+static bool endsIn(const dtNavMesh* nav, dtPolyRef conRef, dtPolyRef ref)
+{
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	nav->getTileAndPolyByRefUnsafe(conRef, &tile, &poly);
+	// Links to the end of a connection are on its second vertex.
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		if (tile->links[i].ref == ref && tile->links[i].edge == 1)
+			return true;
+	}
+	return false;
+}
+
+// Returns true if the polygon has a link to the other one.
+static bool isLinkedTo(const dtNavMesh* nav, dtPolyRef ref, dtPolyRef otherRef)
+{
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		if (tile->links[i].ref == otherRef)
+			return true;
+	}
+	return false;
+}
+
+/// @par
+///
+/// The forward search runs from the start toward the end and the backward
+/// search from the end toward the start, expanding one node in turn. Each
+/// time a search reaches a polygon the other one has visited, the cost of
+/// the joined path is noted. Both searches use the average of the distances
+/// to either end as heuristic, so the searches stop once the two open lists
+/// together cannot lead to a cheaper path than the best one joined so far.
+/// Neighbours that cannot lead to such a path are not added to the node pool.
+///
+/// The lower bound set with setPathCostBound() raises both heuristics the
+/// same way it does in findPath(), bounding the cost from the start to a
+/// polygon and from the polygon to the end each in its own direction.
+/// Polygons it marks as unreachable either way are never entered.
+///
+/// The backward search steps against the links, including one-way off-mesh
+/// connections that lead into a polygon without a link back to them.
+///
+/// Both searches use nodes from their own pool, so up to twice @p maxNodes
+/// nodes of init() are used. The pool of the backward search is allocated
+/// by the first call.
+///
+/// If the backward search runs out of polygons before the two meet, the
+/// forward search continues alone. If the end polygon cannot be reached
+/// through the navigation graph, the last polygon in the path will then be
+/// the nearest the end polygon found by the forward search.
+///
+/// If the path array is to small to hold the full result, it will be filled as 
+/// far as possible from the start polygon toward the end polygon.
+///
+dtStatus dtNavMeshQuery::findPathBidirectional(dtPolyRef startRef, dtPolyRef endRef,
+											   const float* startPos, const float* endPos,
+											   const dtQueryFilter* filter,
+											   dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+	
+	// Validate input
+	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!filter || !path || maxPath <= 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	if (startRef == endRef)
+	{
+		path[0] = startRef;
+		*pathCount = 1;
+		return DT_SUCCESS;
+	}
+	
+	if (dtStatusFailed(allocBackSearch()))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	m_nodePool->clear();
+	m_openList->clear();
+	m_backNodePool->clear();
+	m_backOpenList->clear();
+	
+	// Each search estimates the cost to its goal and from its origin with the
+	// distance and, when set, the path cost bound. The key of a node is its
+	// cost plus half the difference of the two, see above. Both estimate the
+	// cost of the whole path from the start to the end at first.
+	float startGoal = dtVdist(startPos, endPos);
+	if (m_costBound)
+		startGoal = dtMax(startGoal, m_costBound->getLowerBound(startRef, endRef));
+	const float endGoal = startGoal;
+	
+	// Only one-way off-mesh connections lead into polygons without a link back.
+	// The ones around the tile last expanded by the backward search are kept.
+	const bool oneWayLinks = m_nav->getOneWayOffMeshConCount() > 0;
+	static const int MAX_ONE_WAY_CONS = 256;
+	dtPolyRef oneWayCons[MAX_ONE_WAY_CONS];
+	int oneWayConCount = 0;
+	const dtMeshTile* oneWayTile = 0;
+	
+	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtVcopy(startNode->pos, startPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = startGoal * 0.5f * H_SCALE;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	m_openList->push(startNode);
+	
+	dtNode* endNode = m_backNodePool->getNode(endRef);
+	dtVcopy(endNode->pos, endPos);
+	endNode->pidx = 0;
+	endNode->cost = 0;
+	endNode->total = endGoal * 0.5f * H_SCALE;
+	endNode->id = endRef;
+	endNode->flags = DT_NODE_OPEN;
+	m_backOpenList->push(endNode);
+	
+	// Backward keys never drop below the key at the end, which bounds the
+	// backward search once its open list has emptied.
+	const float endKey = endNode->total;
+	
+	dtNode* lastBestNode = startNode;
+	float lastBestNodeCost = dtVdist(startPos, endPos) * H_SCALE;
+	
+	// Best joined path so far, meeting in one polygon.
+	dtNode* meetNode = 0;
+	dtNode* meetBackNode = 0;
+	float meetCost = FLT_MAX;
+	
+	bool outOfNodes = false;
+	
+	// Once the forward search runs out of polygons every way from the start
+	// has been tried. The backward one running out only means the end is
+	// enclosed, the forward search then goes on alone to find the nearest
+	// polygon like findPath does.
+	while (!m_openList->empty())
+	{
+		const float forwardTop = m_openList->top()->total;
+		const float backTop = m_backOpenList->empty() ? endKey : m_backOpenList->top()->total;
+		
+		// No path through open nodes can be cheaper than the one joined.
+		if (forwardTop + backTop >= meetCost)
+			break;
+		
+		// Grow the search that has visited fewer polygons.
+		const bool forward = m_backOpenList->empty() || m_nodePool->getNodeCount() <= m_backNodePool->getNodeCount();
+		
+		dtNodePool* nodePool = forward ? m_nodePool : m_backNodePool;
+		dtNodeQueue* openList = forward ? m_openList : m_backOpenList;
+		dtNodePool* otherNodePool = forward ? m_backNodePool : m_nodePool;
+		const float otherTop = forward ? backTop : forwardTop;
+		const float* goalPos = forward ? endPos : startPos;
+		const float* originPos = forward ? startPos : endPos;
+		
+		// Remove node from open list and put it in closed list.
+		dtNode* bestNode = openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		
+		// Get current poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+		
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef)
+			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+		
+		// The polygons to step to. The backward search steps to the polygons
+		// that link into the current one: all its neighbours, except that an
+		// off-mesh connection is only entered from the ends linked to it, and
+		// one-way connections ending here are only linked from their side.
+		static const int MAX_NEIS = 128;
+		dtPolyRef neighbourRefs[MAX_NEIS];
+		unsigned char neighbourSides[MAX_NEIS];
+		int neighbourCount = 0;
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK && neighbourCount < MAX_NEIS; i = bestTile->links[i].next)
+		{
+			const dtPolyRef neighbourRef = bestTile->links[i].ref;
+			if (!forward && neighbourRef && bestPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION && !isLinkedTo(m_nav, neighbourRef, bestRef))
+				continue;
+			neighbourRefs[neighbourCount] = neighbourRef;
+			neighbourSides[neighbourCount] = bestTile->links[i].side;
+			neighbourCount++;
+		}
+		if (!forward && oneWayLinks && bestPoly->getType() != DT_POLYTYPE_OFFMESH_CONNECTION)
+		{
+			// Polygons of the same tile share the connections around it.
+			if (bestTile != oneWayTile)
+			{
+				oneWayConCount = getOneWayOffMeshConsAround(bestTile, oneWayCons, MAX_ONE_WAY_CONS);
+				oneWayTile = bestTile;
+			}
+			for (int i = 0; i < oneWayConCount && neighbourCount < MAX_NEIS; ++i)
+			{
+				if (!endsIn(m_nav, oneWayCons[i], bestRef))
+					continue;
+				neighbourRefs[neighbourCount] = oneWayCons[i];
+				neighbourSides[neighbourCount] = 0xff;
+				neighbourCount++;
+			}
+		}
+		
+		for (int i = 0; i < neighbourCount; ++i)
+		{
+			dtPolyRef neighbourRef = neighbourRefs[i];
+			
+			// Skip invalid ids and do not expand back to where we came from.
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+			
+			// Get neighbour poly and tile.
+			// The API input has been cheked already, skip checking internal data.
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+			
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+			
+			// Bounds on the cost from the start to the polygon and from the
+			// polygon to the end, the path through it can be neither.
+			float startBound = 0;
+			float endBound = 0;
+			if (m_costBound)
+			{
+				if (neighbourRef != startRef)
+					startBound = m_costBound->getLowerBound(startRef, neighbourRef);
+				if (neighbourRef != endRef)
+					endBound = m_costBound->getLowerBound(neighbourRef, endRef);
+				if (startBound >= FLT_MAX || endBound >= FLT_MAX)
+					continue;
+			}
+			const float goalBound = forward ? endBound : startBound;
+			const float originBound = forward ? startBound : endBound;
+			
+			// deal explicitly with crossing tile boundaries
+			unsigned char crossSide = 0;
+			if (neighbourSides[i] != 0xff)
+				crossSide = neighbourSides[i] >> 1;
+			
+			// Nodes are only allocated once they are worth opening, until then
+			// the position is kept aside.
+			dtNode* neighbourNode = nodePool->findNode(neighbourRef, crossSide);
+			float neighbourPos[3];
+			if (neighbourNode && neighbourNode->flags != 0)
+			{
+				dtVcopy(neighbourPos, neighbourNode->pos);
+			}
+			else
+			{
+				getEdgeMidPoint(bestRef, bestPoly, bestTile,
+								neighbourRef, neighbourPoly, neighbourTile,
+								neighbourPos);
+			}
+			
+			// Calculate cost and heuristic. Both directions charge the
+			// segment inside bestPoly, so costs add up the same way.
+			const float curCost = filter->getCost(bestNode->pos, neighbourPos,
+												  parentRef, parentTile, parentPoly,
+												  bestRef, bestTile, bestPoly,
+												  neighbourRef, neighbourTile, neighbourPoly);
+			const float cost = bestNode->cost + curCost;
+			const float heuristic = dtVdist(neighbourPos, goalPos)*H_SCALE;
+			const float goalEstimate = dtMax(heuristic, goalBound*H_SCALE);
+			const float originEstimate = dtMax(dtVdist(neighbourPos, originPos)*H_SCALE, originBound*H_SCALE);
+			const float total = cost + (goalEstimate - originEstimate) * 0.5f;
+			
+			// The node is already in open list and the new result is worse, skip.
+			if (neighbourNode && (neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			// The node is already visited and process, and the new result is worse, skip.
+			if (neighbourNode && (neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
+				continue;
+			
+			// Join with the other search where it has reached this polygon,
+			// crossing the polygon between the two node positions.
+			dtNode* otherNodes[DT_MAX_STATES_PER_NODE];
+			const int otherCount = (int)otherNodePool->findNodes(neighbourRef, otherNodes, DT_MAX_STATES_PER_NODE);
+			dtNode* joinNode = 0;
+			float joinPathCost = meetCost;
+			for (int j = 0; j < otherCount; ++j)
+			{
+				dtNode* otherNode = otherNodes[j];
+				const float joinCost = filter->getCost(neighbourPos, otherNode->pos,
+													   0, 0, 0,
+													   neighbourRef, neighbourTile, neighbourPoly,
+													   0, 0, 0);
+				const float pathCost = cost + otherNode->cost + joinCost;
+				if (pathCost < joinPathCost)
+				{
+					joinPathCost = pathCost;
+					joinNode = otherNode;
+				}
+			}
+			
+			// Paths on through the node cost at least its key plus the
+			// smallest key of the other search.
+			if (!joinNode && total + otherTop >= meetCost)
+				continue;
+			
+			// get the node
+			if (!neighbourNode)
+			{
+				neighbourNode = nodePool->getNode(neighbourRef, crossSide);
+				if (!neighbourNode)
+				{
+					outOfNodes = true;
+					continue;
+				}
+			}
+			if (neighbourNode->flags == 0)
+				dtVcopy(neighbourNode->pos, neighbourPos);
+			
+			// Add or update the node.
+			neighbourNode->pidx = nodePool->getNodeIdx(bestNode);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+			neighbourNode->cost = cost;
+			neighbourNode->total = total;
+			
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				// Already in open, update node location.
+				openList->modify(neighbourNode);
+			}
+			else
+			{
+				// Put the node in open list.
+				neighbourNode->flags |= DT_NODE_OPEN;
+				openList->push(neighbourNode);
+			}
+			
+			// Update nearest node to target so far.
+			if (forward && heuristic < lastBestNodeCost)
+			{
+				lastBestNodeCost = heuristic;
+				lastBestNode = neighbourNode;
+			}
+			
+			if (joinNode)
+			{
+				meetCost = joinPathCost;
+				meetNode = forward ? neighbourNode : joinNode;
+				meetBackNode = forward ? joinNode : neighbourNode;
+			}
+		}
+	}
+	
+	dtStatus status;
+	if (meetNode)
+	{
+		// Start to meeting polygon from the forward pool, then on to the end
+		// from the backward pool.
+		int forwardLength = 0;
+		for (dtNode* curNode = meetNode; curNode; curNode = m_nodePool->getNodeAtIdx(curNode->pidx))
+			forwardLength++;
+		int backLength = 0;
+		for (dtNode* curNode = m_backNodePool->getNodeAtIdx(meetBackNode->pidx); curNode; curNode = m_backNodePool->getNodeAtIdx(curNode->pidx))
+			backLength++;
+		
+		// If the path cannot be fully stored keep the part from the start.
+		dtNode* curNode = meetNode;
+		int writeCount;
+		for (writeCount = forwardLength; writeCount > maxPath; writeCount--)
+			curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
+		for (int i = writeCount - 1; i >= 0; i--)
+		{
+			path[i] = curNode->id;
+			curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
+		}
+		int n = writeCount;
+		for (curNode = m_backNodePool->getNodeAtIdx(meetBackNode->pidx); curNode && n < maxPath; curNode = m_backNodePool->getNodeAtIdx(curNode->pidx))
+			path[n++] = curNode->id;
+		*pathCount = n;
+		
+		status = DT_SUCCESS;
+		if (forwardLength + backLength > maxPath)
+			status |= DT_BUFFER_TOO_SMALL;
+	}
+	else
+	{
+		status = getPathToNode(lastBestNode, path, pathCount, maxPath);
+		if (lastBestNode->id != endRef)
+			status |= DT_PARTIAL_RESULT;
+	}
+	
+	if (outOfNodes)
+		status |= DT_OUT_OF_NODES;
+	
+	return status;
+}
+
 
 /// @par
 ///
@@ -1746,6 +2256,67 @@ dtStatus dtNavMeshQuery::appendPortals(const int startIdx, const int endIdx, con
 	return DT_IN_PROGRESS;
 }
 
+/// @par
+///
+/// Each polygon is crossed between the midpoints of its portal edges, from
+/// @p startPos and to @p endPos, so a corridor returned by findPath costs what
+/// the search found it at.
+///
+dtStatus dtNavMeshQuery::getPathCost(const float* startPos, const float* endPos,
+									 const dtPolyRef* path, const int pathSize,
+									 const dtQueryFilter* filter, float* cost) const
+{
+	dtAssert(m_nav);
+	
+	if (!startPos || !endPos || !path || pathSize <= 0 || !filter || !cost)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	*cost = 0;
+	
+	dtPolyRef prevRef = 0;
+	const dtMeshTile* prevTile = 0;
+	const dtPoly* prevPoly = 0;
+	const dtMeshTile* curTile = 0;
+	const dtPoly* curPoly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(path[0], &curTile, &curPoly)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	float pos[3], nextPos[3];
+	dtVcopy(pos, startPos);
+	for (int i = 0; i < pathSize; ++i)
+	{
+		dtPolyRef nextRef = 0;
+		const dtMeshTile* nextTile = 0;
+		const dtPoly* nextPoly = 0;
+		if (i+1 < pathSize)
+		{
+			nextRef = path[i+1];
+			if (dtStatusFailed(m_nav->getTileAndPolyByRef(nextRef, &nextTile, &nextPoly)))
+				return DT_FAILURE | DT_INVALID_PARAM;
+			if (dtStatusFailed(getEdgeMidPoint(path[i], curPoly, curTile, nextRef, nextPoly, nextTile, nextPos)))
+				return DT_FAILURE | DT_INVALID_PARAM;
+		}
+		else
+		{
+			dtVcopy(nextPos, endPos);
+		}
+		
+		*cost += filter->getCost(pos, nextPos,
+								 prevRef, prevTile, prevPoly,
+								 path[i], curTile, curPoly,
+								 nextRef, nextTile, nextPoly);
+		
+		prevRef = path[i];
+		prevTile = curTile;
+		prevPoly = curPoly;
+		curTile = nextTile;
+		curPoly = nextPoly;
+		dtVcopy(pos, nextPos);
+	}
+	
+	return DT_SUCCESS;
+}
+
 /// @par
 /// 
 /// This method peforms what is often called 'string pulling'.
@@ -48,58 +48,67 @@ inline unsigned int dtHashRef(dtPolyRef a)
 #endif
 
 //////////////////////////////////////////////////////////////////////////////////////////
+static const unsigned int DT_NODE_SLOT_INDEX_MASK = (1u << DT_NODE_PARENT_BITS) - 1;
+
+inline unsigned int dtNodeSlotData(unsigned int idx, unsigned char state)
+{
+	return (idx + 1) | ((unsigned int)state << DT_NODE_PARENT_BITS);
+}
+
 dtNodePool::dtNodePool(int maxNodes, int hashSize) :
 	m_nodes(0),
-	m_first(0),
-	m_next(0),
+	m_hash(0),
+	m_slots(0),
 	m_maxNodes(maxNodes),
 	m_hashSize(hashSize),
-	m_nodeCount(0)
+	m_nodeCount(0),
+	m_allocCount(0)
 {
 	dtAssert(dtNextPow2(m_hashSize) == (unsigned int)m_hashSize);
 	// pidx is special as 0 means "none" and 1 is the first node. For that reason
 	// we have 1 fewer nodes available than the number of values it can contain.
-	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_NULL_IDX && m_maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
+	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_MAX_NODES);
+	// A full table would have no empty slot to end a probe.
+	dtAssert(m_hashSize > m_maxNodes);
 
 	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
-	m_next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_maxNodes, DT_ALLOC_PERM);
-	m_first = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*hashSize, DT_ALLOC_PERM);
+	m_slots = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_maxNodes, DT_ALLOC_PERM);
+	m_hash = (dtNodeSlot*)dtAlloc(sizeof(dtNodeSlot)*m_hashSize, DT_ALLOC_PERM);
 
 	dtAssert(m_nodes);
-	dtAssert(m_next);
-	dtAssert(m_first);
+	dtAssert(m_slots);
+	dtAssert(m_hash);
 
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
-	memset(m_next, 0xff, sizeof(dtNodeIndex)*m_maxNodes);
+	memset(m_hash, 0, sizeof(dtNodeSlot)*m_hashSize);
 }
 
 dtNodePool::~dtNodePool()
 {
 	dtFree(m_nodes);
-	dtFree(m_next);
-	dtFree(m_first);
+	dtFree(m_slots);
+	dtFree(m_hash);
 }
 
 void dtNodePool::clear()
 {
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	// Most searches touch a small part of the table, only empty what they used.
+	for (int i = 0; i < m_nodeCount; ++i)
+		m_hash[m_slots[i]].data = 0;
 	m_nodeCount = 0;
 }
 
 unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNodes)
 {
 	int n = 0;
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	while (i != DT_NULL_IDX)
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	for (unsigned int i = dtHashRef(id) & mask; m_hash[i].data; i = (i+1) & mask)
 	{
-		if (m_nodes[i].id == id)
+		if (m_hash[i].id == id)
 		{
 			if (n >= maxNodes)
 				return n;
-			nodes[n++] = &m_nodes[i];
+			nodes[n++] = &m_nodes[(m_hash[i].data & DT_NODE_SLOT_INDEX_MASK) - 1];
 		}
-		i = m_next[i];
 	}
 
 	return n;
@@ -107,37 +116,37 @@ unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNo
 
 dtNode* dtNodePool::findNode(dtPolyRef id, unsigned char state)
 {
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	while (i != DT_NULL_IDX)
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	const unsigned int stateBits = (unsigned int)state << DT_NODE_PARENT_BITS;
+	for (unsigned int i = dtHashRef(id) & mask; m_hash[i].data; i = (i+1) & mask)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
-		i = m_next[i];
+		if (m_hash[i].id == id && (m_hash[i].data & ~DT_NODE_SLOT_INDEX_MASK) == stateBits)
+			return &m_nodes[(m_hash[i].data & DT_NODE_SLOT_INDEX_MASK) - 1];
 	}
 	return 0;
 }
 
 dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 {
-	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
-	dtNode* node = 0;
-	while (i != DT_NULL_IDX)
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	const unsigned int stateBits = (unsigned int)state << DT_NODE_PARENT_BITS;
+	unsigned int slot = dtHashRef(id) & mask;
+	for (; m_hash[slot].data; slot = (slot+1) & mask)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
-		i = m_next[i];
+		if (m_hash[slot].id == id && (m_hash[slot].data & ~DT_NODE_SLOT_INDEX_MASK) == stateBits)
+			return &m_nodes[(m_hash[slot].data & DT_NODE_SLOT_INDEX_MASK) - 1];
 	}
 	
 	if (m_nodeCount >= m_maxNodes)
 		return 0;
 	
-	i = (dtNodeIndex)m_nodeCount;
+	// The probe ended on an empty slot, the new node takes it.
+	const dtNodeIndex i = (dtNodeIndex)m_nodeCount;
 	m_nodeCount++;
+	m_allocCount++;
 	
 	// Init node
-	node = &m_nodes[i];
+	dtNode* node = &m_nodes[i];
 	node->pidx = 0;
 	node->cost = 0;
 	node->total = 0;
@@ -145,28 +154,52 @@ dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 	node->state = state;
 	node->flags = 0;
 	
-	m_next[i] = m_first[bucket];
-	m_first[bucket] = i;
+	m_hash[slot].id = id;
+	m_hash[slot].data = dtNodeSlotData(i, state);
+	m_slots[i] = (dtNodeIndex)slot;
 	
 	return node;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-dtNodeQueue::dtNodeQueue(int n) :
+dtNodeQueue::dtNodeQueue(int n, dtNodeQueueType type, dtNodePool* pool) :
 	m_heap(0),
+	m_entryData(0),
+	m_entries(0),
+	m_positions(0),
+	m_pool(pool),
+	m_type(type),
 	m_capacity(n),
-	m_size(0)
+	m_size(0),
+	m_pushCount(0)
 {
 	dtAssert(m_capacity > 0);
 	
-	m_heap = (dtNode**)dtAlloc(sizeof(dtNode*)*(m_capacity+1), DT_ALLOC_PERM);
-	dtAssert(m_heap);
+	if (m_type == DT_NODE_QUEUE_QUATERNARY_HEAP)
+	{
+		dtAssert(m_pool);
+		// The root sits 3 entries past an aligned address, so the children
+		// 4i+1 to 4i+4 of every entry start on an aligned address.
+		m_entryData = dtAlloc(sizeof(dtNodeQueueEntry)*(m_capacity+3) + DT_NODE_QUEUE_ALIGNMENT, DT_ALLOC_PERM);
+		dtAssert(m_entryData);
+		const size_t aligned = ((size_t)m_entryData + DT_NODE_QUEUE_ALIGNMENT-1) & ~(size_t)(DT_NODE_QUEUE_ALIGNMENT-1);
+		m_entries = (dtNodeQueueEntry*)aligned + 3;
+		m_positions = (int*)dtAlloc(sizeof(int)*(m_pool->getMaxNodes()+1), DT_ALLOC_PERM);
+		dtAssert(m_positions);
+	}
+	else
+	{
+		m_heap = (dtNode**)dtAlloc(sizeof(dtNode*)*(m_capacity+1), DT_ALLOC_PERM);
+		dtAssert(m_heap);
+	}
 }
 
 dtNodeQueue::~dtNodeQueue()
 {
 	dtFree(m_heap);
+	dtFree(m_entryData);
+	dtFree(m_positions);
 }
 
 void dtNodeQueue::bubbleUp(int i, dtNode* node)
@@ -198,3 +231,42 @@ void dtNodeQueue::trickleDown(int i, dtNode* node)
 	}
 	bubbleUp(i, node);
 }
+
+void dtNodeQueue::bubbleUpEntry(int i, dtNodeQueueEntry entry)
+{
+	int parent = (i-1)/4;
+	// note: (index > 0) means there is a parent
+	while ((i > 0) && (m_entries[parent].total > entry.total))
+	{
+		m_entries[i] = m_entries[parent];
+		m_positions[m_entries[i].idx] = i;
+		i = parent;
+		parent = (i-1)/4;
+	}
+	m_entries[i] = entry;
+	m_positions[entry.idx] = i;
+}
+
+void dtNodeQueue::trickleDownEntry(int i, dtNodeQueueEntry entry)
+{
+	int child = (i*4)+1;
+	while (child < m_size)
+	{
+		// Smallest of up to four children.
+		const int last = dtMin(child+4, m_size);
+		int best = child;
+		for (int j = child+1; j < last; ++j)
+		{
+			if (m_entries[j].total < m_entries[best].total)
+				best = j;
+		}
+		if (m_entries[best].total >= entry.total)
+			break;
+		m_entries[i] = m_entries[best];
+		m_positions[m_entries[i].idx] = i;
+		i = best;
+		child = (i*4)+1;
+	}
+	m_entries[i] = entry;
+	m_positions[entry.idx] = i;
+}
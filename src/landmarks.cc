@@ -0,0 +1,441 @@
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <queue>
+
+#include "DetourCommon.h"
+#include "landmarks.h"
+
+typedef std::pair<float, int> HeapEntry;
+typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > MinHeap;
+
+// dtQueryFilter::passFilter is only defined inside Detour, this mirrors the
+// default implementation.
+static inline bool PassFilter(const dtQueryFilter *filter, const dtPoly *poly) {
+	return (poly->flags & filter->getIncludeFlags()) != 0 && (poly->flags & filter->getExcludeFlags()) == 0;
+}
+
+static void PolyCenter(const dtMeshTile *tile, const dtPoly *poly, float *center) {
+	dtVset(center, 0.0f, 0.0f, 0.0f);
+	for (int index = 0; index < poly->vertCount; index++) {
+		dtVadd(center, center, &tile->verts[poly->verts[index] * 3]);
+	}
+	dtVscale(center, center, 1.0f / poly->vertCount);
+}
+
+// Where findPath crosses from poly into the polygon link leads to, the
+// middle of their shared edge or the end point of an off-mesh connection,
+// see dtNavMeshQuery::getPortalPoints.
+static void PortalMidpoint(const dtNavMesh *navMesh, dtPolyRef ref, const dtMeshTile *tile, const dtPoly *poly, const dtLink &link, float *mid) {
+	if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION) {
+		dtVcopy(mid, &tile->verts[poly->verts[link.edge] * 3]);
+		return;
+	}
+	const dtMeshTile *toTile = NULL;
+	const dtPoly *toPoly = NULL;
+	navMesh->getTileAndPolyByRefUnsafe(link.ref, &toTile, &toPoly);
+	if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION) {
+		for (unsigned int k = toPoly->firstLink; k != DT_NULL_LINK; k = toTile->links[k].next) {
+			if (toTile->links[k].ref == ref) {
+				dtVcopy(mid, &toTile->verts[toPoly->verts[toTile->links[k].edge] * 3]);
+				return;
+			}
+		}
+	}
+	const float *va = &tile->verts[poly->verts[link.edge] * 3];
+	const float *vb = &tile->verts[poly->verts[(link.edge + 1) % poly->vertCount] * 3];
+	dtVlerp(mid, va, vb, 0.5f);
+}
+
+// Cost of the longest straight move inside poly, how far the cost recorded
+// for it can be from that of the end position.
+static float PolyExtent(const dtQueryFilter *filter, const dtMeshTile *tile, const dtPoly *poly) {
+	float extent = 0.0f;
+	for (int a = 0; a < poly->vertCount; a++) {
+		for (int b = a + 1; b < poly->vertCount; b++) {
+			extent = dtMax(extent, dtVdist(&tile->verts[poly->verts[a] * 3], &tile->verts[poly->verts[b] * 3]));
+		}
+	}
+	return extent * filter->getAreaCost(poly->getArea());
+}
+
+// FNV-1a over the layout and vertices of every tile.
+static unsigned int HashNavMesh(const dtNavMesh *navMesh) {
+	unsigned int hash = 2166136261u;
+	for (int tileIndex = 0; tileIndex < navMesh->getMaxTiles(); tileIndex++) {
+		const dtMeshTile *tile = navMesh->getTile(tileIndex);
+		if (!tile || !tile->header) {
+			continue;
+		}
+		const int layout[] = { tileIndex, tile->header->x, tile->header->y, tile->header->layer, tile->header->polyCount, tile->header->vertCount };
+		const unsigned char *bytes = (const unsigned char*)layout;
+		for (size_t index = 0; index < sizeof(layout); index++) {
+			hash = (hash ^ bytes[index]) * 16777619u;
+		}
+		bytes = (const unsigned char*)tile->verts;
+		for (size_t index = 0; index < tile->header->vertCount * 3 * sizeof(float); index++) {
+			hash = (hash ^ bytes[index]) * 16777619u;
+		}
+	}
+	return hash;
+}
+
+LandmarkTable::LandmarkTable() : m_navMesh(NULL), m_version(0), m_meshHash(0), m_filterHash(0), m_landmarkCount(0) {
+}
+
+void LandmarkTable::Index(const dtNavMesh *navMesh, unsigned int version) {
+	m_navMesh = navMesh;
+	m_version = version;
+	m_meshHash = HashNavMesh(navMesh);
+	const int maxTiles = navMesh->getMaxTiles();
+	m_tileFirst.assign(maxTiles + 1, 0);
+	int polyCount = 0;
+	for (int tileIndex = 0; tileIndex < maxTiles; tileIndex++) {
+		m_tileFirst[tileIndex] = polyCount;
+		const dtMeshTile *tile = navMesh->getTile(tileIndex);
+		if (tile && tile->header) {
+			polyCount += tile->header->polyCount;
+		}
+	}
+	m_tileFirst[maxTiles] = polyCount;
+}
+
+int LandmarkTable::PolyIndex(dtPolyRef ref) const {
+	const unsigned int tileIndex = m_navMesh->decodePolyIdTile(ref);
+	if (tileIndex + 1 >= m_tileFirst.size()) {
+		return -1;
+	}
+	const int index = m_tileFirst[tileIndex] + (int)m_navMesh->decodePolyIdPoly(ref);
+	return index < m_tileFirst[tileIndex + 1] ? index : -1;
+}
+
+// Dijkstra from the center of source over the portal midpoints, the way
+// findPath moves between polygons. Backward searches follow the links
+// against their direction and record the cost from every polygon to
+// source instead.
+void LandmarkTable::Search(const std::vector<dtPolyRef> &refs, const std::vector<int> &inFirst, const std::vector<InLink> &inLinks,
+	const dtQueryFilter *filter, int source, bool backward, std::vector<float> &costs) const {
+	const int polyCount = (int)refs.size();
+	std::vector<float> positions(polyCount * 3);
+	costs.assign(polyCount, FLT_MAX);
+	const dtMeshTile *sourceTile = NULL;
+	const dtPoly *sourcePoly = NULL;
+	m_navMesh->getTileAndPolyByRefUnsafe(refs[source], &sourceTile, &sourcePoly);
+	PolyCenter(sourceTile, sourcePoly, &positions[source * 3]);
+	costs[source] = 0.0f;
+	MinHeap heap;
+	heap.push(HeapEntry(0.0f, source));
+	while (!heap.empty()) {
+		const HeapEntry entry = heap.top();
+		heap.pop();
+		const int current = entry.second;
+		if (entry.first > costs[current]) {
+			continue;
+		}
+		const dtMeshTile *tile = NULL;
+		const dtPoly *poly = NULL;
+		m_navMesh->getTileAndPolyByRefUnsafe(refs[current], &tile, &poly);
+		const float areaCost = filter->getAreaCost(poly->getArea());
+		if (!backward) {
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next) {
+				const dtLink &link = tile->links[k];
+				const int neighbour = link.ref ? PolyIndex(link.ref) : -1;
+				if (neighbour < 0 || !refs[neighbour]) {
+					continue;
+				}
+				float mid[3];
+				PortalMidpoint(m_navMesh, refs[current], tile, poly, link, mid);
+				const float cost = costs[current] + dtVdist(&positions[current * 3], mid) * areaCost;
+				if (cost < costs[neighbour]) {
+					costs[neighbour] = cost;
+					dtVcopy(&positions[neighbour * 3], mid);
+					heap.push(HeapEntry(cost, neighbour));
+				}
+			}
+		} else {
+			// Moving from the neighbour into current costs the way across
+			// current, charged at its area cost like findPath does.
+			for (int in = inFirst[current]; in < inFirst[current + 1]; in++) {
+				const int neighbour = inLinks[in].poly;
+				const dtMeshTile *neighbourTile = NULL;
+				const dtPoly *neighbourPoly = NULL;
+				m_navMesh->getTileAndPolyByRefUnsafe(refs[neighbour], &neighbourTile, &neighbourPoly);
+				float mid[3];
+				PortalMidpoint(m_navMesh, refs[neighbour], neighbourTile, neighbourPoly, neighbourTile->links[inLinks[in].link], mid);
+				const float cost = costs[current] + dtVdist(&positions[current * 3], mid) * areaCost;
+				if (cost < costs[neighbour]) {
+					costs[neighbour] = cost;
+					dtVcopy(&positions[neighbour * 3], mid);
+					heap.push(HeapEntry(cost, neighbour));
+				}
+			}
+		}
+	}
+}
+
+// Drops the unused columns of a polygon by landmark table built for more
+// landmarks than were found.
+static void Pack(std::vector<float> &costs, int polyCount, int landmarkCount, int usedCount) {
+	if (costs.empty()) {
+		return;
+	}
+	std::vector<float> packed((size_t)polyCount * usedCount);
+	for (int index = 0; index < polyCount && usedCount > 0; index++) {
+		memcpy(&packed[(size_t)index * usedCount], &costs[(size_t)index * landmarkCount], usedCount * sizeof(float));
+	}
+	costs.swap(packed);
+}
+
+void LandmarkTable::Build(const dtNavMesh *navMesh, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash, int landmarkCount) {
+	Index(navMesh, version);
+	m_filterHash = filterHash;
+	m_landmarkCount = landmarkCount;
+	m_landmarks.clear();
+	const int maxTiles = navMesh->getMaxTiles();
+	const int polyCount = m_tileFirst[maxTiles];
+
+	// Off-mesh connections take part like findPath uses them. One-way ones
+	// make the cost between two polygons depend on the direction, the costs
+	// back to every landmark are then recorded as well.
+	std::vector<dtPolyRef> refs(polyCount, 0);
+	m_extents.assign(polyCount, 0.0f);
+	int first = -1;
+	bool directed = false;
+	for (int tileIndex = 0; tileIndex < maxTiles; tileIndex++) {
+		const dtMeshTile *tile = navMesh->getTile(tileIndex);
+		if (!tile || !tile->header) {
+			continue;
+		}
+		const dtPolyRef base = navMesh->getPolyRefBase(tile);
+		for (int polyIndex = 0; polyIndex < tile->header->polyCount; polyIndex++) {
+			const dtPoly *poly = &tile->polys[polyIndex];
+			if (!PassFilter(filter, poly)) {
+				continue;
+			}
+			const int index = m_tileFirst[tileIndex] + polyIndex;
+			refs[index] = base | (dtPolyRef)polyIndex;
+			m_extents[index] = PolyExtent(filter, tile, poly);
+			if (first < 0) {
+				first = index;
+			}
+		}
+		for (int conIndex = 0; conIndex < tile->header->offMeshConCount; conIndex++) {
+			if (!(tile->offMeshCons[conIndex].flags & DT_OFFMESH_CON_BIDIR)) {
+				directed = true;
+			}
+		}
+	}
+
+	// Links into every polygon, polygon by polygon, for the backward searches.
+	std::vector<int> inFirst;
+	std::vector<InLink> inLinks;
+	if (directed) {
+		inFirst.assign(polyCount + 1, 0);
+		for (int index = 0; index < polyCount; index++) {
+			if (!refs[index]) {
+				continue;
+			}
+			const dtMeshTile *tile = NULL;
+			const dtPoly *poly = NULL;
+			navMesh->getTileAndPolyByRefUnsafe(refs[index], &tile, &poly);
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next) {
+				const int neighbour = tile->links[k].ref ? PolyIndex(tile->links[k].ref) : -1;
+				if (neighbour >= 0 && refs[neighbour]) {
+					inFirst[neighbour + 1]++;
+				}
+			}
+		}
+		for (int index = 0; index < polyCount; index++) {
+			inFirst[index + 1] += inFirst[index];
+		}
+		inLinks.resize(inFirst[polyCount]);
+		std::vector<int> inNext(inFirst.begin(), inFirst.end() - 1);
+		for (int index = 0; index < polyCount; index++) {
+			if (!refs[index]) {
+				continue;
+			}
+			const dtMeshTile *tile = NULL;
+			const dtPoly *poly = NULL;
+			navMesh->getTileAndPolyByRefUnsafe(refs[index], &tile, &poly);
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next) {
+				const int neighbour = tile->links[k].ref ? PolyIndex(tile->links[k].ref) : -1;
+				if (neighbour >= 0 && refs[neighbour]) {
+					InLink &in = inLinks[inNext[neighbour]++];
+					in.poly = index;
+					in.link = k;
+				}
+			}
+		}
+	}
+
+	std::vector<float> costs;
+	std::vector<float> backCosts;
+	std::vector<float> nearest(polyCount, FLT_MAX);
+	m_costs.assign((size_t)polyCount * landmarkCount, FLT_MAX);
+	m_backCosts.clear();
+	if (directed) {
+		m_backCosts.assign((size_t)polyCount * landmarkCount, FLT_MAX);
+	}
+	int source = first;
+	// The first search only finds a polygon far from an arbitrary one.
+	for (int pass = -1; pass < landmarkCount && source >= 0; pass++) {
+		Search(refs, inFirst, inLinks, filter, source, false, costs);
+
+		if (pass >= 0) {
+			m_landmarks.push_back(source);
+			if (directed) {
+				Search(refs, inFirst, inLinks, filter, source, true, backCosts);
+			}
+			for (int index = 0; index < polyCount; index++) {
+				m_costs[(size_t)index * landmarkCount + pass] = costs[index];
+				if (directed) {
+					m_backCosts[(size_t)index * landmarkCount + pass] = backCosts[index];
+				}
+				nearest[index] = pass == 0 ? costs[index] : dtMin(nearest[index], costs[index]);
+			}
+		} else {
+			nearest = costs;
+		}
+
+		// Next landmark: farthest from all picked so far. Polygons no
+		// landmark reaches yet come first, so islands get their own.
+		int next = -1;
+		float farthest = 0.0f;
+		for (int index = 0; index < polyCount; index++) {
+			if (refs[index] && nearest[index] > farthest) {
+				farthest = nearest[index];
+				next = index;
+			}
+		}
+		source = next;
+	}
+	m_landmarkCount = (int)m_landmarks.size();
+	if (m_landmarkCount < landmarkCount) {
+		Pack(m_costs, polyCount, landmarkCount, m_landmarkCount);
+		Pack(m_backCosts, polyCount, landmarkCount, m_landmarkCount);
+	}
+}
+
+void LandmarkTable::Save(std::vector<unsigned char> &data) const {
+	LandmarkTableHeader header;
+	header.magic = LANDMARKS_MAGIC;
+	header.version = LANDMARKS_VERSION;
+	header.meshHash = m_meshHash;
+	header.filterHash = m_filterHash;
+	header.landmarkCount = m_landmarkCount;
+	header.polyCount = (int)m_extents.size();
+	header.directed = m_backCosts.empty() ? 0 : 1;
+	const size_t landmarksSize = m_landmarks.size() * sizeof(int);
+	const size_t extentsSize = m_extents.size() * sizeof(float);
+	const size_t costsSize = m_costs.size() * sizeof(float);
+	const size_t backCostsSize = m_backCosts.size() * sizeof(float);
+	data.resize(sizeof(header) + landmarksSize + extentsSize + costsSize + backCostsSize);
+	unsigned char *cursor = &data[0];
+	memcpy(cursor, &header, sizeof(header));
+	cursor += sizeof(header);
+	if (landmarksSize > 0) {
+		memcpy(cursor, &m_landmarks[0], landmarksSize);
+		cursor += landmarksSize;
+	}
+	if (extentsSize > 0) {
+		memcpy(cursor, &m_extents[0], extentsSize);
+		cursor += extentsSize;
+	}
+	if (costsSize > 0) {
+		memcpy(cursor, &m_costs[0], costsSize);
+		cursor += costsSize;
+	}
+	if (backCostsSize > 0) {
+		memcpy(cursor, &m_backCosts[0], backCostsSize);
+	}
+}
+
+bool LandmarkTable::Load(const dtNavMesh *navMesh, unsigned int version, const unsigned char *data, size_t dataSize, char *error, size_t errorSize) {
+	LandmarkTableHeader header;
+	if (dataSize < sizeof(header)) {
+		snprintf(error, errorSize, "Truncated landmark table");
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != LANDMARKS_MAGIC) {
+		snprintf(error, errorSize, "Not a landmark table");
+		return false;
+	}
+	if (header.version != LANDMARKS_VERSION) {
+		snprintf(error, errorSize, "Unsupported landmark table version %d", header.version);
+		return false;
+	}
+	Index(navMesh, version);
+	if (header.meshHash != m_meshHash || header.polyCount != m_tileFirst[navMesh->getMaxTiles()]) {
+		snprintf(error, errorSize, "The landmark table was built for another navmesh");
+		return false;
+	}
+	if (header.landmarkCount < 0 || header.landmarkCount > MAX_LANDMARKS) {
+		snprintf(error, errorSize, "Invalid landmark count %d", header.landmarkCount);
+		return false;
+	}
+	const size_t polyCount = (size_t)header.polyCount;
+	const size_t landmarksSize = header.landmarkCount * sizeof(int);
+	const size_t extentsSize = polyCount * sizeof(float);
+	const size_t costsSize = polyCount * header.landmarkCount * sizeof(float);
+	const size_t backCostsSize = header.directed ? costsSize : 0;
+	if (dataSize - sizeof(header) < landmarksSize + extentsSize + costsSize + backCostsSize) {
+		snprintf(error, errorSize, "Truncated landmark table");
+		return false;
+	}
+	const unsigned char *cursor = data + sizeof(header);
+	m_filterHash = header.filterHash;
+	m_landmarkCount = header.landmarkCount;
+	m_landmarks.resize(header.landmarkCount);
+	m_extents.resize(polyCount);
+	m_costs.resize(polyCount * header.landmarkCount);
+	m_backCosts.resize(header.directed ? polyCount * header.landmarkCount : 0);
+	if (landmarksSize > 0) {
+		memcpy(&m_landmarks[0], cursor, landmarksSize);
+		cursor += landmarksSize;
+	}
+	if (extentsSize > 0) {
+		memcpy(&m_extents[0], cursor, extentsSize);
+		cursor += extentsSize;
+	}
+	if (costsSize > 0) {
+		memcpy(&m_costs[0], cursor, costsSize);
+		cursor += costsSize;
+	}
+	if (backCostsSize > 0) {
+		memcpy(&m_backCosts[0], cursor, backCostsSize);
+	}
+	return true;
+}
+
+bool LandmarkTable::Matches(const dtNavMesh *navMesh, unsigned int version, unsigned int filterHash) const {
+	return m_landmarkCount > 0 && navMesh == m_navMesh && version == m_version && filterHash == m_filterHash;
+}
+
+float LandmarkTable::getLowerBound(dtPolyRef ref, dtPolyRef endRef) const {
+	const int index = PolyIndex(ref);
+	const int endIndex = PolyIndex(endRef);
+	if (index < 0 || endIndex < 0) {
+		return 0.0f;
+	}
+	// Without one-way links the costs back to a landmark are those from it.
+	const std::vector<float> &backCosts = m_backCosts.empty() ? m_costs : m_backCosts;
+	const float *costs = &m_costs[(size_t)index * m_landmarkCount];
+	const float *endCosts = &m_costs[(size_t)endIndex * m_landmarkCount];
+	const float *backCostsFrom = &backCosts[(size_t)index * m_landmarkCount];
+	const float *endBackCosts = &backCosts[(size_t)endIndex * m_landmarkCount];
+	float bound = 0.0f;
+	for (int landmark = 0; landmark < m_landmarkCount; landmark++) {
+		// The way from the landmark to the end may lead through the polygon,
+		// the way from the polygon to the landmark may lead through the end.
+		// Polygons some landmark does not reach tell nothing about each other.
+		if (costs[landmark] != FLT_MAX && endCosts[landmark] != FLT_MAX) {
+			bound = dtMax(bound, endCosts[landmark] - costs[landmark]);
+		}
+		if (backCostsFrom[landmark] != FLT_MAX && endBackCosts[landmark] != FLT_MAX) {
+			bound = dtMax(bound, backCostsFrom[landmark] - endBackCosts[landmark]);
+		}
+	}
+	return dtMax(0.0f, bound - m_extents[endIndex]);
+}
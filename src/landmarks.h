@@ -0,0 +1,108 @@
+#ifndef NAVQUERY_LANDMARKS_H
+#define NAVQUERY_LANDMARKS_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+// Landmark (ALT) lower bounds for findPath. A few landmark polygons are
+// picked far apart and the cost from each of them to every polygon is stored.
+// By the triangle inequality the cost from a polygon to the end polygon is at
+// least the difference of their costs to any landmark, which unlike the
+// straight line distance accounts for walls and detours.
+//
+// Costs are recorded at one position per polygon, the bound subtracts the
+// extent of the end polygon to stay below the cost to the end position. It
+// is the same for the whole search, which keeps the heuristic about as
+// consistent as the landmark costs themselves.
+//
+// Off-mesh connections are followed in the direction they may be taken.
+// When some of them are one-way the cost back from every polygon to each
+// landmark is recorded too, the bound then uses both.
+//
+// Serialized tables are bound to the mesh they were built for by a hash of
+// its tiles and to the filter by HashQueryFilter. They are never modified
+// after Build or Load, so any number of threads may use one at once.
+//
+//   LandmarkTableHeader
+//   int[landmarkCount]                 landmark polygon indices
+//   float[polyCount]                   polygon extents
+//   float[polyCount * landmarkCount]   costs, polygon by polygon
+//   float[polyCount * landmarkCount]   costs back to the landmarks, only
+//                                      when directed is set
+//
+// Polygons are numbered tile by tile in tile index order. Unreachable
+// polygons have cost FLT_MAX.
+static const int LANDMARKS_MAGIC = 'N'<<24 | 'L'<<16 | 'M'<<8 | 'K'; //'NLMK';
+static const int LANDMARKS_VERSION = 2;
+static const int MAX_LANDMARKS = 64;
+
+struct LandmarkTableHeader {
+	int magic;
+	int version;
+	unsigned int meshHash;
+	unsigned int filterHash;
+	int landmarkCount;
+	int polyCount;
+	int directed;
+};
+
+class LandmarkTable : public dtPathCostBound {
+public:
+	LandmarkTable();
+
+	// Picks landmarkCount landmarks, each the polygon farthest from those
+	// picked before, and records the costs to every polygon of navMesh that
+	// passes filter.
+	void Build(const dtNavMesh *navMesh, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash, int landmarkCount);
+
+	// Writes the serialized table to data.
+	void Save(std::vector<unsigned char> &data) const;
+
+	// Reads a table Save wrote for navMesh. Returns false and writes a
+	// message to error when data is not such a table.
+	bool Load(const dtNavMesh *navMesh, unsigned int version, const unsigned char *data, size_t dataSize, char *error, size_t errorSize);
+
+	// The bound only holds for the mesh, flags version and filter it was
+	// built for.
+	bool Matches(const dtNavMesh *navMesh, unsigned int version, unsigned int filterHash) const;
+
+	inline int GetLandmarkCount() const { return m_landmarkCount; }
+
+	virtual float getLowerBound(dtPolyRef ref, dtPolyRef endRef) const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	LandmarkTable(const LandmarkTable&);
+	LandmarkTable& operator=(const LandmarkTable&);
+
+	// A link of polygon poly leading into another polygon.
+	struct InLink {
+		int poly;
+		unsigned int link;
+	};
+
+	void Index(const dtNavMesh *navMesh, unsigned int version);
+	void Search(const std::vector<dtPolyRef> &refs, const std::vector<int> &inFirst, const std::vector<InLink> &inLinks,
+		const dtQueryFilter *filter, int source, bool backward, std::vector<float> &costs) const;
+	int PolyIndex(dtPolyRef ref) const;
+
+	const dtNavMesh *m_navMesh;
+	unsigned int m_version;
+	unsigned int m_meshHash;
+	unsigned int m_filterHash;
+	int m_landmarkCount;
+
+	// Polygons of tile index i are numbered from m_tileFirst[i] up to
+	// m_tileFirst[i + 1].
+	std::vector<int> m_tileFirst;
+	std::vector<int> m_landmarks;
+	std::vector<float> m_extents;
+	std::vector<float> m_costs;
+	// Empty unless the mesh has one-way off-mesh connections.
+	std::vector<float> m_backCosts;
+};
+
+#endif // NAVQUERY_LANDMARKS_H
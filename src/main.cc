@@ -1,38 +1,964 @@
 #include <node.h>
 #include <nan.h>
+#include <uv.h>
+#include <float.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "Sample.h"
+#include "DetourCommon.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
+#include "DetourNode.h"
+#include "landmarks.h"
+#include "navmesh.h"
+#include "pathcache.h"
+#include "portalgraph.h"
+#include "querystats.h"
+#include "randompoints.h"
+#include "tileset.h"
 
 using namespace v8;
 
-static float frand() {
-	return (float)rand()/(float)RAND_MAX;
+// Detour takes a plain function for random numbers, this points it at the
+// generator of the NavQuery calling it.
+static thread_local RandomGenerator *currentGenerator;
+
+static float CurrentGeneratorFloat() {
+	return currentGenerator->NextFloat();
+}
+
+// Property names are created once so hot paths do not allocate a string per
+// property access. Like every persistent handle of the addon they exist once
+// per thread, as each worker_threads isolate loads the addon on its own.
+struct PropertyKeys {
+	Nan::Persistent<v8::String> x;
+	Nan::Persistent<v8::String> y;
+	Nan::Persistent<v8::String> z;
+	Nan::Persistent<v8::String> ref;
+	Nan::Persistent<v8::String> flags;
+
+	static inline PropertyKeys & get() {
+		static thread_local PropertyKeys keys;
+		return keys;
+	}
+
+	void Init() {
+		x.Reset(Nan::New("x").ToLocalChecked());
+		y.Reset(Nan::New("y").ToLocalChecked());
+		z.Reset(Nan::New("z").ToLocalChecked());
+		ref.Reset(Nan::New("ref").ToLocalChecked());
+		flags.Reset(Nan::New("flags").ToLocalChecked());
+	}
+
+	void Reset() {
+		x.Reset();
+		y.Reset();
+		z.Reset();
+		ref.Reset();
+		flags.Reset();
+	}
+};
+
+// Reads a {x,y,z,ref} object as returned by findNearestPoly.
+static void ReadPosition(v8::Local<v8::Value> value, float *pos, dtPolyRef *ref) {
+	PropertyKeys &keys = PropertyKeys::get();
+	v8::Local<v8::Object> object = Nan::To<v8::Object>(value).ToLocalChecked();
+	pos[0] = (float)Nan::To<double>(Nan::Get(object, Nan::New(keys.x)).ToLocalChecked()).FromJust();
+	pos[1] = (float)Nan::To<double>(Nan::Get(object, Nan::New(keys.y)).ToLocalChecked()).FromJust();
+	pos[2] = (float)Nan::To<double>(Nan::Get(object, Nan::New(keys.z)).ToLocalChecked()).FromJust();
+	if (ref) {
+		*ref = Nan::To<uint32_t>(Nan::Get(object, Nan::New(keys.ref)).ToLocalChecked()).FromJust();
+	}
+}
+
+static v8::Local<v8::Array> StraightPathToArray(const float *straightPath, const unsigned char *straightPathFlags, const dtPolyRef *straightPathRefs, int straightPathCount) {
+	PropertyKeys &keys = PropertyKeys::get();
+	v8::Local<v8::Array> result = Nan::New<v8::Array>(straightPathCount);
+	for (int index = 0; index < straightPathCount; index++) {
+		v8::Local<v8::Object> vector3 = Nan::New<v8::Object>();
+		const int cursor = index * 3;
+		Nan::Set(vector3, Nan::New(keys.x), Nan::New(straightPath[cursor + 0]));
+		Nan::Set(vector3, Nan::New(keys.y), Nan::New(straightPath[cursor + 1]));
+		Nan::Set(vector3, Nan::New(keys.z), Nan::New(straightPath[cursor + 2]));
+		Nan::Set(vector3, Nan::New(keys.ref), Nan::New(straightPathRefs[index]));
+		Nan::Set(vector3, Nan::New(keys.flags), Nan::New(straightPathFlags[index]));
+		Nan::Set(result, index, vector3);
+	}
+	return result;
+}
+
+template <typename ArrayType, typename T>
+static v8::Local<ArrayType> CopyToTypedArray(const T *data, size_t length) {
+	v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), length * sizeof(T));
+	v8::Local<ArrayType> array = ArrayType::New(buffer, 0, length);
+	if (length > 0) {
+		Nan::TypedArrayContents<T> contents(array);
+		memcpy(*contents, data, length * sizeof(T));
+	}
+	return array;
+}
+
+// Base for queries run on the libuv threadpool. Settles either the node-style
+// callback passed by the caller or the returned Promise.
+class NavQueryWorker : public Nan::AsyncWorker {
+public:
+	NavQueryWorker(Nan::Callback *callback) : Nan::AsyncWorker(callback, "navquery:NavQueryWorker") {
+	}
+
+	v8::Local<v8::Value> Queue() {
+		Nan::EscapableHandleScope scope;
+		v8::Local<v8::Value> returnValue = Nan::Undefined();
+		if (!callback) {
+			v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+			SaveToPersistent("resolver", resolver);
+			returnValue = resolver->GetPromise();
+		}
+		Nan::AsyncQueueWorker(this);
+		return scope.Escape(returnValue);
+	}
+protected:
+	virtual v8::Local<v8::Value> Result() = 0;
+
+	void HandleOKCallback() {
+		Nan::HandleScope scope;
+		v8::Local<v8::Value> result = Result();
+		if (callback) {
+			v8::Local<v8::Value> argv[] = { Nan::Null(), result };
+			callback->Call(2, argv, async_resource);
+			return;
+		}
+		GetFromPersistent("resolver").As<v8::Promise::Resolver>()->Resolve(Nan::GetCurrentContext(), result).FromJust();
+	}
+
+	void HandleErrorCallback() {
+		Nan::HandleScope scope;
+		v8::Local<v8::Value> error = Nan::Error(ErrorMessage());
+		if (callback) {
+			v8::Local<v8::Value> argv[] = { error };
+			callback->Call(1, argv, async_resource);
+			return;
+		}
+		GetFromPersistent("resolver").As<v8::Promise::Resolver>()->Reject(Nan::GetCurrentContext(), error).FromJust();
+	}
+};
+
+// A dtNavMeshQuery together with preallocated buffers for path searches, so
+// queries do not put maxPath sized arrays on the stack.
+struct QueryContext {
+	dtNavMeshQuery *navQuery;
+	std::vector<dtPolyRef> path;
+	std::vector<float> straightPath;
+	std::vector<unsigned char> straightPathFlags;
+	std::vector<dtPolyRef> straightPathRefs;
+
+	QueryContext() {
+		navQuery = dtAllocNavMeshQuery();
+	}
+	~QueryContext() {
+		dtFreeNavMeshQuery(navQuery);
+		navQuery = NULL;
+	}
+
+	dtStatus Init(const dtNavMesh *navMesh, int maxNodes, int maxPath, dtNodeQueueType openList) {
+		if (!navQuery) {
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		path.resize(maxPath);
+		straightPath.resize(maxPath * 3);
+		straightPathFlags.resize(maxPath);
+		straightPathRefs.resize(maxPath);
+		return navQuery->init(navMesh, maxNodes, openList);
+	}
+
+	inline int GetMaxPath() const {
+		return (int)path.size();
+	}
+};
+
+// Runs findStraightPath over a polygon corridor and sets the return value.
+// When info[outIndex] is a Float32Array the corners go straight into it and
+// the optional Uint32Array refs / Uint8Array flags after it, and only the
+// corner count is returned. Otherwise an array of {x,y,z,ref,flags} objects.
+static void SetStraightPathResult(Nan::NAN_METHOD_ARGS_TYPE info, int outIndex, QueryContext &context, const float *startPos, const float *endPos, const dtPolyRef *path, int pathCount) {
+	dtStatus status = 0;
+	if (info[outIndex]->IsFloat32Array()) {
+		Nan::TypedArrayContents<float> points(info[outIndex]);
+		int maxStraightPath = (int)(points.length() / 3);
+		dtPolyRef *refs = NULL;
+		unsigned char *flags = NULL;
+		if (info[outIndex + 1]->IsUint32Array()) {
+			Nan::TypedArrayContents<unsigned int> refsContents(info[outIndex + 1]);
+			refs = *refsContents;
+			maxStraightPath = dtMin(maxStraightPath, (int)refsContents.length());
+		}
+		if (info[outIndex + 2]->IsUint8Array()) {
+			Nan::TypedArrayContents<unsigned char> flagsContents(info[outIndex + 2]);
+			flags = *flagsContents;
+			maxStraightPath = dtMin(maxStraightPath, (int)flagsContents.length());
+		}
+		int straightPathCount = 0;
+		if (maxStraightPath > 0) {
+			status = context.navQuery->findStraightPath(startPos, endPos, path, pathCount, *points, flags, refs, &straightPathCount, maxStraightPath, 0);
+		} else {
+			status = DT_FAILURE | DT_INVALID_PARAM;
+		}
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+			return;
+		}
+		info.GetReturnValue().Set(Nan::New(straightPathCount));
+		return;
+	}
+	int straightPathCount = 0;
+	status = context.navQuery->findStraightPath(startPos, endPos, path, pathCount, &context.straightPath[0], &context.straightPathFlags[0], &context.straightPathRefs[0], &straightPathCount, context.GetMaxPath(), 0);
+	if (dtStatusFailed(status)) {
+		info.GetReturnValue().Set(Nan::New(status));
+		return;
+	}
+	info.GetReturnValue().Set(StraightPathToArray(&context.straightPath[0], &context.straightPathFlags[0], &context.straightPathRefs[0], straightPathCount));
+}
+
+static const int DEFAULT_MAX_NODES = 2048;
+static const int DEFAULT_MAX_PATH = 2048;
+
+// Reads the optional { maxNodes, maxPath } options accepted by the NavQuery
+// constructor and load. Throws and returns false when a value is out of range.
+static bool ReadQueryOptions(v8::Local<v8::Value> value, int *maxNodes, int *maxPath) {
+	if (!value->IsObject()) {
+		return true;
+	}
+	v8::Local<v8::Object> options = Nan::To<v8::Object>(value).ToLocalChecked();
+	v8::Local<v8::Value> maxNodesValue = Nan::Get(options, Nan::New("maxNodes").ToLocalChecked()).ToLocalChecked();
+	v8::Local<v8::Value> maxPathValue = Nan::Get(options, Nan::New("maxPath").ToLocalChecked()).ToLocalChecked();
+	if (!maxNodesValue->IsUndefined()) {
+		int nodes = Nan::To<int>(maxNodesValue).FromJust();
+		if (nodes < 1 || nodes > DT_MAX_NODES) {
+			Nan::ThrowRangeError("The \"maxNodes\" option must be between 1 and 16777215");
+			return false;
+		}
+		*maxNodes = nodes;
+	}
+	if (!maxPathValue->IsUndefined()) {
+		int path = Nan::To<int>(maxPathValue).FromJust();
+		if (path < 1) {
+			Nan::ThrowRangeError("The \"maxPath\" option must be a positive integer");
+			return false;
+		}
+		*maxPath = path;
+	}
+	return true;
+}
+
+static const double DEFAULT_STREAM_BUDGET = 64 * 1024 * 1024;
+static const int DEFAULT_STREAM_MARGIN = 1;
+
+// File options of load and loadAsync. { mmap: true } maps the file instead of
+// reading it, { stream: true, budget, margin } loads the tiles of a tile set
+// as queries touch them and keeps at most budget bytes of tile data.
+struct LoadOptions {
+	bool mmap;
+	bool stream;
+	size_t budget;
+	int margin;
+};
+
+static bool ReadLoadOptions(v8::Local<v8::Value> value, LoadOptions *loadOptions) {
+	loadOptions->mmap = false;
+	loadOptions->stream = false;
+	loadOptions->budget = (size_t)DEFAULT_STREAM_BUDGET;
+	loadOptions->margin = DEFAULT_STREAM_MARGIN;
+	if (!value->IsObject()) {
+		return true;
+	}
+	v8::Local<v8::Object> options = Nan::To<v8::Object>(value).ToLocalChecked();
+	loadOptions->mmap = Nan::To<bool>(Nan::Get(options, Nan::New("mmap").ToLocalChecked()).ToLocalChecked()).FromJust();
+	loadOptions->stream = Nan::To<bool>(Nan::Get(options, Nan::New("stream").ToLocalChecked()).ToLocalChecked()).FromJust();
+	v8::Local<v8::Value> budgetValue = Nan::Get(options, Nan::New("budget").ToLocalChecked()).ToLocalChecked();
+	v8::Local<v8::Value> marginValue = Nan::Get(options, Nan::New("margin").ToLocalChecked()).ToLocalChecked();
+	if (!budgetValue->IsUndefined()) {
+		double budget = Nan::To<double>(budgetValue).FromJust();
+		if (!(budget >= 0)) {
+			Nan::ThrowRangeError("The \"budget\" option must be a number of bytes");
+			return false;
+		}
+		loadOptions->budget = (size_t)budget;
+	}
+	if (!marginValue->IsUndefined()) {
+		int margin = Nan::To<int>(marginValue).FromJust();
+		if (margin < 0) {
+			Nan::ThrowRangeError("The \"margin\" option must be a number of tiles");
+			return false;
+		}
+		loadOptions->margin = margin;
+	}
+	return true;
+}
+
+static SharedNavMesh *LoadNavMesh(const char *path, const LoadOptions &loadOptions, char *error, size_t errorSize) {
+	if (loadOptions.stream) {
+		return StreamNavMeshFile(path, loadOptions.budget, loadOptions.margin, error, errorSize);
+	}
+	if (loadOptions.mmap) {
+		return MapNavMeshFile(path, error, errorSize);
+	}
+	return LoadNavMeshFile(path, error, errorSize);
+}
+
+// Streams in the tiles a query is going to search, when the mesh is streamed,
+// and keeps them from being removed until the scope ends. Without bounds only
+// the tiles already resident are searched. Path searches are padded by the
+// margin of the mesh, and widened while they come back partial.
+class ResidentScope {
+public:
+	ResidentScope(SharedNavMesh *navMesh, const float *bmin, const float *bmax, bool path) : m_streamer(navMesh->GetStreamer()), m_padding(0), m_path(false) {
+		if (!m_streamer) {
+			return;
+		}
+		if (bmin) {
+			dtVcopy(m_bmin, bmin);
+			dtVcopy(m_bmax, bmax);
+			m_padding = path ? m_streamer->GetMargin() : 0;
+			m_path = path;
+			m_streamer->EnsureResident(m_bmin, m_bmax, m_padding);
+		}
+		m_streamer->LockShared();
+	}
+	~ResidentScope() {
+		if (m_streamer) {
+			m_streamer->UnlockShared();
+		}
+	}
+
+	// A streamed path search that returned DT_PARTIAL_RESULT may have been cut
+	// short by tiles that are not resident, and a complete one may have missed
+	// a cheaper way through them. Loads a region twice as wide and returns
+	// true when the search is worth repeating: until the region holds the
+	// whole mesh or every way out of it costs more than the corridor found.
+	bool Widen(dtStatus status, const dtNavMeshQuery *navQuery, const dtQueryFilter *filter, const float *startPos, const float *endPos, const dtPolyRef *path, int pathCount) {
+		if (!m_streamer || !m_path || dtStatusFailed(status)) {
+			return false;
+		}
+		const float detour = m_streamer->MinDetour(m_bmin, m_bmax, m_padding, startPos, endPos);
+		if (detour == FLT_MAX) {
+			return false;
+		}
+		if (!dtStatusDetail(status, DT_PARTIAL_RESULT)) {
+			float minAreaCost = FLT_MAX;
+			for (int area = 0; area < DT_MAX_AREAS; area++) {
+				minAreaCost = dtMin(minAreaCost, filter->getAreaCost(area));
+			}
+			float cost = 0;
+			if (dtStatusSucceed(navQuery->getPathCost(startPos, endPos, path, pathCount, filter, &cost)) && cost <= detour * minAreaCost) {
+				return false;
+			}
+		}
+		m_padding = m_padding * 2 + 1;
+		m_streamer->UnlockShared();
+		m_streamer->EnsureResident(m_bmin, m_bmax, m_padding);
+		m_streamer->LockShared();
+		return true;
+	}
+private:
+	TileStreamer *m_streamer;
+	float m_bmin[3];
+	float m_bmax[3];
+	int m_padding;
+	bool m_path;
+};
+
+static void PathBounds(const float *startPos, const float *endPos, float *bmin, float *bmax) {
+	dtVcopy(bmin, startPos);
+	dtVmin(bmin, endPos);
+	dtVcopy(bmax, startPos);
+	dtVmax(bmax, endPos);
+}
+
+// findPath through an optional path cache and portal graph. Only complete
+// corridors are stored, partial results depend on how far the search got.
+// Searches the portal graph declines, e.g. between close end points, run
+// flat, from both ends at once with bidirectional set. A landmark table
+// built for the filter tightens the findPath heuristic.
+static dtStatus CachedFindPath(PathCache *pathCache, const PortalGraph *portalGraph, const LandmarkTable *landmarks, bool bidirectional, SharedNavMesh *navMesh, dtNavMeshQuery *navQuery, ResidentScope &residentScope,
+	dtPolyRef startRef, dtPolyRef endRef, const float *startPos, const float *endPos, const dtQueryFilter *filter,
+	dtPolyRef *path, int *pathCount, int maxPath) {
+	unsigned int filterHash = 0;
+	unsigned int version = navMesh->GetVersion();
+	if (pathCache || portalGraph || landmarks) {
+		filterHash = HashQueryFilter(filter);
+	}
+	if (pathCache && pathCache->Lookup(navMesh->Get(), version, startRef, endRef, filterHash, path, pathCount, maxPath)) {
+		return DT_SUCCESS;
+	}
+	if (landmarks && landmarks->Matches(navMesh->Get(), version, filterHash)) {
+		navQuery->setPathCostBound(landmarks);
+	}
+	dtStatus status = 0;
+	if (!portalGraph || !portalGraph->FindPath(navQuery, version, filter, filterHash, startRef, endRef, startPos, endPos, path, pathCount, maxPath, &status)) {
+		do {
+			if (bidirectional) {
+				status = navQuery->findPathBidirectional(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+			} else {
+				status = navQuery->findPath(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+			}
+		} while (residentScope.Widen(status, navQuery, filter, startPos, endPos, path, *pathCount));
+	}
+	navQuery->setPathCostBound(NULL);
+	if (pathCache && dtStatusSucceed(status) && !dtStatusDetail(status, DT_PARTIAL_RESULT) && *pathCount > 0 && path[*pathCount - 1] == endRef) {
+		pathCache->Store(navMesh->Get(), version, startRef, endRef, filterHash, path, *pathCount);
+	}
+	return status;
+}
+
+static v8::Local<v8::Value> TileStatsToObject(SharedNavMesh *navMesh) {
+	if (!navMesh->GetStreamer()) {
+		return Nan::Null();
+	}
+	TileStreamerStats stats = navMesh->GetStreamer()->GetStats();
+	v8::Local<v8::Object> result = Nan::New<v8::Object>();
+	Nan::Set(result, Nan::New("residentTiles").ToLocalChecked(), Nan::New(stats.residentTiles));
+	Nan::Set(result, Nan::New("residentBytes").ToLocalChecked(), Nan::New((double)stats.residentBytes));
+	Nan::Set(result, Nan::New("loads").ToLocalChecked(), Nan::New((double)stats.loads));
+	Nan::Set(result, Nan::New("evictions").ToLocalChecked(), Nan::New((double)stats.evictions));
+	Nan::Set(result, Nan::New("failures").ToLocalChecked(), Nan::New((double)stats.failures));
+	return result;
+}
+
+static void ReleaseBackingStore(void *releaseData) {
+	delete (std::shared_ptr<v8::BackingStore>*)releaseData;
+}
+
+// loadFromBuffer(buffer, { inPlace: true }) lets Detour use the bytes of the
+// Buffer/ArrayBuffer directly. The backing store is kept alive by the mesh,
+// but the caller must not modify the bytes afterwards.
+static SharedNavMesh *LoadNavMeshBuffer(v8::Local<v8::Value> value, v8::Local<v8::Value> options, char *error, size_t errorSize) {
+	v8::Local<v8::ArrayBuffer> arrayBuffer;
+	size_t byteOffset = 0;
+	size_t byteLength = 0;
+	if (value->IsArrayBuffer()) {
+		arrayBuffer = value.As<v8::ArrayBuffer>();
+		byteLength = arrayBuffer->ByteLength();
+	} else if (value->IsArrayBufferView()) {
+		v8::Local<v8::ArrayBufferView> view = value.As<v8::ArrayBufferView>();
+		arrayBuffer = view->Buffer();
+		byteOffset = view->ByteOffset();
+		byteLength = view->ByteLength();
+	} else {
+		snprintf(error, errorSize, "The \"buffer\" argument must be a Buffer, TypedArray or ArrayBuffer");
+		return NULL;
+	}
+	bool inPlace = false;
+	if (options->IsObject()) {
+		inPlace = Nan::To<bool>(Nan::Get(options.As<v8::Object>(), Nan::New("inPlace").ToLocalChecked()).ToLocalChecked()).FromJust();
+	}
+	std::shared_ptr<v8::BackingStore> backingStore = arrayBuffer->GetBackingStore();
+	unsigned char *data = (unsigned char*)backingStore->Data() + byteOffset;
+	dtNavMesh *navMesh = CreateNavMesh(data, byteLength, !inPlace, error, errorSize);
+	if (!navMesh) {
+		return NULL;
+	}
+	if (!inPlace) {
+		return new SharedNavMesh(navMesh);
+	}
+	return new SharedNavMesh(navMesh, ReleaseBackingStore, new std::shared_ptr<v8::BackingStore>(backingStore));
+}
+
+// share() hands out a SharedArrayBuffer that NavMesh and NavQuery objects in
+// other worker_threads attach to. Its bytes carry nothing: the address of its
+// backing store is looked up in sharedHandles, so JS can neither forge nor
+// corrupt a handle. The backing store holds a reference to the mesh until
+// every isolate has dropped it.
+static const size_t SHARED_HANDLE_SIZE = 8;
+static uv_once_t sharedHandlesOnce = UV_ONCE_INIT;
+static uv_mutex_t sharedHandlesMutex;
+static std::map<void*, SharedNavMesh*> *sharedHandles;
+
+static void InitSharedHandles() {
+	uv_mutex_init(&sharedHandlesMutex);
+	sharedHandles = new std::map<void*, SharedNavMesh*>();
+}
+
+// Runs on whichever thread drops the last SharedArrayBuffer.
+static void ReleaseSharedHandle(void *data, size_t /*length*/, void *deleterData) {
+	uv_mutex_lock(&sharedHandlesMutex);
+	sharedHandles->erase(data);
+	uv_mutex_unlock(&sharedHandlesMutex);
+	((SharedNavMesh*)deleterData)->Unref();
+	free(data);
+}
+
+static v8::Local<v8::SharedArrayBuffer> ShareNavMesh(SharedNavMesh *navMesh) {
+	uv_once(&sharedHandlesOnce, InitSharedHandles);
+	void *data = calloc(1, SHARED_HANDLE_SIZE);
+	navMesh->Ref();
+	uv_mutex_lock(&sharedHandlesMutex);
+	(*sharedHandles)[data] = navMesh;
+	uv_mutex_unlock(&sharedHandlesMutex);
+	std::shared_ptr<v8::BackingStore> backingStore = v8::SharedArrayBuffer::NewBackingStore(data, SHARED_HANDLE_SIZE, ReleaseSharedHandle, navMesh);
+	return v8::SharedArrayBuffer::New(v8::Isolate::GetCurrent(), backingStore);
+}
+
+// Returns a new reference to the mesh behind a handle made by share(), or
+// NULL when value is not one.
+static SharedNavMesh *ImportSharedNavMesh(v8::Local<v8::Value> value) {
+	if (!value->IsSharedArrayBuffer()) {
+		return NULL;
+	}
+	uv_once(&sharedHandlesOnce, InitSharedHandles);
+	void *data = value.As<v8::SharedArrayBuffer>()->GetBackingStore()->Data();
+	SharedNavMesh *navMesh = NULL;
+	uv_mutex_lock(&sharedHandlesMutex);
+	std::map<void*, SharedNavMesh*>::iterator it = sharedHandles->find(data);
+	if (it != sharedHandles->end()) {
+		navMesh = it->second;
+		navMesh->Ref();
+	}
+	uv_mutex_unlock(&sharedHandlesMutex);
+	return navMesh;
+}
+
+// A navmesh loaded once and attached to any number of NavQuery objects.
+class NavMesh : public Nan::ObjectWrap {
+private:
+	SharedNavMesh *m_navMesh;
+
+	NavMesh() {
+		m_navMesh = new SharedNavMesh(dtAllocNavMesh());
+	}
+	~NavMesh() {
+		m_navMesh->Unref();
+		m_navMesh = NULL;
+	}
+public:
+	inline SharedNavMesh *GetSharedNavMesh() const {
+		return m_navMesh;
+	}
+
+	void SetSharedNavMesh(SharedNavMesh *navMesh) {
+		m_navMesh->Unref();
+		m_navMesh = navMesh;
+	}
+
+	static NAN_METHOD(New) {
+		if (info.IsConstructCall()) {
+			NavMesh *thisObject = new NavMesh();
+			thisObject->Wrap(info.This());
+			info.GetReturnValue().Set(info.This());
+		}
+	}
+
+	// Replaces the mesh of this object. NavQuery objects attached earlier keep
+	// the previous mesh until they are attached again.
+	static NAN_METHOD(Load) {
+		Isolate *isolate = info.GetIsolate();
+		NavMesh* thisObject = Nan::ObjectWrap::Unwrap<NavMesh>(info.Holder());
+		if (info[0]->IsString() == false) {
+			isolate->ThrowException(Nan::Error("The \"path\" argument must be of type string"));
+			return;
+		}
+		LoadOptions loadOptions;
+		if (!ReadLoadOptions(info[1], &loadOptions)) {
+			return;
+		}
+		char charBuffer[1024];
+		Nan::Utf8String path(info[0]);
+
+		Nan::Set(info.This(), Nan::New("filename").ToLocalChecked(), info[0]);
+
+		SharedNavMesh *navMesh = LoadNavMesh(*path, loadOptions, charBuffer, sizeof(charBuffer));
+		if (!navMesh) {
+			isolate->ThrowException(Nan::Error(charBuffer));
+			return;
+		}
+		thisObject->SetSharedNavMesh(navMesh);
+		info.GetReturnValue().Set(Nan::True());
+	}
+
+	static NAN_METHOD(LoadAsync);
+
+	static NAN_METHOD(LoadFromBuffer) {
+		NavMesh* thisObject = Nan::ObjectWrap::Unwrap<NavMesh>(info.Holder());
+		char charBuffer[1024];
+		SharedNavMesh *navMesh = LoadNavMeshBuffer(info[0], info[1], charBuffer, sizeof(charBuffer));
+		if (!navMesh) {
+			info.GetIsolate()->ThrowException(Nan::Error(charBuffer));
+			return;
+		}
+		thisObject->SetSharedNavMesh(navMesh);
+		info.GetReturnValue().Set(Nan::True());
+	}
+
+	// share() returns a SharedArrayBuffer handle to this mesh for postMessage.
+	static NAN_METHOD(Share) {
+		NavMesh* thisObject = Nan::ObjectWrap::Unwrap<NavMesh>(info.Holder());
+		info.GetReturnValue().Set(ShareNavMesh(thisObject->m_navMesh));
+	}
+
+	// attach(handle) uses the mesh shared by share() in another thread.
+	static NAN_METHOD(Attach) {
+		NavMesh* thisObject = Nan::ObjectWrap::Unwrap<NavMesh>(info.Holder());
+		SharedNavMesh *navMesh = ImportSharedNavMesh(info[0]);
+		if (!navMesh) {
+			info.GetIsolate()->ThrowException(Nan::Error("The \"handle\" argument must be a SharedArrayBuffer returned by share()"));
+			return;
+		}
+		thisObject->SetSharedNavMesh(navMesh);
+		info.GetReturnValue().Set(Nan::True());
+	}
+
+	// Residency counters of a streamed mesh, null otherwise.
+	static NAN_METHOD(GetTileStats) {
+		NavMesh* thisObject = Nan::ObjectWrap::Unwrap<NavMesh>(info.Holder());
+		info.GetReturnValue().Set(TileStatsToObject(thisObject->m_navMesh));
+	}
+
+	static inline Nan::Persistent<v8::FunctionTemplate> & functionTemplate() {
+		static thread_local Nan::Persistent<v8::FunctionTemplate> functionTemplate;
+		return functionTemplate;
+	}
+
+	static bool HasInstance(v8::Local<v8::Value> value) {
+		return value->IsObject() && Nan::New(functionTemplate())->HasInstance(value);
+	}
+};
+
+// A dtQueryFilter passed to individual queries, so unit types with different
+// area costs and flags can share one NavQuery. A frozen filter can no longer
+// change and is shared by async queries instead of being copied.
+class QueryFilter : public Nan::ObjectWrap {
+private:
+	dtQueryFilter m_filter;
+	bool m_frozen;
+
+	QueryFilter() : m_frozen(false) {
+	}
+
+	// Throws unless the filter may still be changed.
+	bool CheckMutable() {
+		if (m_frozen) {
+			Nan::ThrowError("The QueryFilter is frozen");
+			return false;
+		}
+		return true;
+	}
+
+	static bool ReadArea(v8::Local<v8::Value> value, int *area) {
+		*area = Nan::To<int>(value).FromMaybe(-1);
+		if (*area < 0 || *area >= DT_MAX_AREAS) {
+			Nan::ThrowRangeError("The \"area\" argument must be between 0 and 63");
+			return false;
+		}
+		return true;
+	}
+public:
+	inline const dtQueryFilter *Get() const {
+		return &m_filter;
+	}
+
+	inline bool IsFrozen() const {
+		return m_frozen;
+	}
+
+	static NAN_METHOD(New) {
+		if (info.IsConstructCall()) {
+			QueryFilter *thisObject = new QueryFilter();
+			thisObject->Wrap(info.This());
+			info.GetReturnValue().Set(info.This());
+		}
+	}
+
+	static NAN_METHOD(GetAreaCost) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		int area = 0;
+		if (!ReadArea(info[0], &area)) {
+			return;
+		}
+		info.GetReturnValue().Set(Nan::New(thisObject->m_filter.getAreaCost(area)));
+	}
+
+	static NAN_METHOD(SetAreaCost) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		int area = 0;
+		if (!thisObject->CheckMutable() || !ReadArea(info[0], &area)) {
+			return;
+		}
+		thisObject->m_filter.setAreaCost(area, (float)Nan::To<double>(info[1]).FromJust());
+	}
+
+	static NAN_METHOD(GetIncludeFlags) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		info.GetReturnValue().Set(Nan::New(thisObject->m_filter.getIncludeFlags()));
+	}
+
+	static NAN_METHOD(SetIncludeFlags) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		if (!thisObject->CheckMutable()) {
+			return;
+		}
+		thisObject->m_filter.setIncludeFlags((unsigned short)Nan::To<int>(info[0]).FromJust());
+	}
+
+	static NAN_METHOD(GetExcludeFlags) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		info.GetReturnValue().Set(Nan::New(thisObject->m_filter.getExcludeFlags()));
+	}
+
+	static NAN_METHOD(SetExcludeFlags) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		if (!thisObject->CheckMutable()) {
+			return;
+		}
+		thisObject->m_filter.setExcludeFlags((unsigned short)Nan::To<int>(info[0]).FromJust());
+	}
+
+	// freeze() makes the filter immutable and returns it.
+	static NAN_METHOD(Freeze) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		thisObject->m_frozen = true;
+		info.GetReturnValue().Set(info.Holder());
+	}
+
+	static NAN_METHOD(IsFrozen) {
+		QueryFilter* thisObject = Nan::ObjectWrap::Unwrap<QueryFilter>(info.Holder());
+		info.GetReturnValue().Set(Nan::New(thisObject->m_frozen));
+	}
+
+	static inline Nan::Persistent<v8::FunctionTemplate> & functionTemplate() {
+		static thread_local Nan::Persistent<v8::FunctionTemplate> functionTemplate;
+		return functionTemplate;
+	}
+
+	static bool HasInstance(v8::Local<v8::Value> value) {
+		return value->IsObject() && Nan::New(functionTemplate())->HasInstance(value);
+	}
+};
+
+// Queries take an optional QueryFilter after their other arguments, before a
+// callback. Returns its index from first on, or -1.
+static int FindFilterArgument(Nan::NAN_METHOD_ARGS_TYPE info, int first) {
+	for (int index = first; index < info.Length(); index++) {
+		if (QueryFilter::HasInstance(info[index])) {
+			return index;
+		}
+	}
+	return -1;
+}
+
+static const dtQueryFilter *GetQueryFilter(Nan::NAN_METHOD_ARGS_TYPE info, int first, const dtQueryFilter *fallback) {
+	int index = FindFilterArgument(info, first);
+	if (index < 0) {
+		return fallback;
+	}
+	return Nan::ObjectWrap::Unwrap<QueryFilter>(info[index].As<v8::Object>())->Get();
 }
 
 class NavQuery : public Nan::ObjectWrap {
 private:
 	dtQueryFilter m_filter;
 
-	dtNavMesh *m_navMesh;
-	dtNavMeshQuery *m_navQuery;
+	SharedNavMesh *m_navMesh;
+	QueryContext m_context;
+	int m_maxNodes;
+	int m_maxPath;
+	PathCache *m_pathCache;
+	// Shared with threadpool workers, which keep the graph they were queued
+	// with alive.
+	std::shared_ptr<const PortalGraph> m_portalGraph;
+	std::shared_ptr<const LandmarkTable> m_landmarks;
+	bool m_bidirectional;
+	dtNodeQueueType m_openList;
+	QueryStats *m_stats;
+	RandomGenerator m_random;
+	RandomPointTable m_randomPoints;
 
-	NavQuery() {
-		m_navMesh = dtAllocNavMesh();
-		m_navQuery = dtAllocNavMeshQuery();
+	// Idle contexts for threadpool workers. Each running worker owns one
+	// exclusively, the shared dtNavMesh is only read.
+	uv_mutex_t m_workerMutex;
+	std::vector<QueryContext*> m_workerContexts;
+
+	NavQuery(int maxNodes, int maxPath, int pathCacheSize, bool bidirectional, dtNodeQueueType openList, bool stats, unsigned long long seed) : m_random(seed) {
+		m_navMesh = new SharedNavMesh(dtAllocNavMesh());
+		m_maxNodes = maxNodes;
+		m_maxPath = maxPath;
+		m_pathCache = NULL;
+		m_bidirectional = bidirectional;
+		m_openList = openList;
+		m_stats = stats ? new QueryStats() : NULL;
+		if (pathCacheSize > 0) {
+			m_pathCache = new PathCache(pathCacheSize);
+			m_pathCache->Reset(m_navMesh->Get());
+		}
+		uv_mutex_init(&m_workerMutex);
 	}
 	~NavQuery() {
-		dtFreeNavMesh(m_navMesh);
+		delete m_pathCache;
+		m_pathCache = NULL;
+		delete m_stats;
+		m_stats = NULL;
+		for (size_t index = 0; index < m_workerContexts.size(); index++) {
+			delete m_workerContexts[index];
+		}
+		m_workerContexts.clear();
+		uv_mutex_destroy(&m_workerMutex);
+		m_navMesh->Unref();
 		m_navMesh = NULL;
-		dtFreeNavMeshQuery(m_navQuery);
-		m_navQuery = NULL;
 	}
 public:
+	// Takes over the reference to navMesh. Queries already running on the
+	// threadpool keep searching the previous mesh until they complete.
+	void SetNavMesh(SharedNavMesh *navMesh, int maxNodes, int maxPath) {
+		m_navMesh->Unref();
+		m_navMesh = navMesh;
+		m_maxNodes = maxNodes;
+		m_maxPath = maxPath;
+		m_context.Init(m_navMesh->Get(), maxNodes, maxPath, m_openList);
+		if (m_pathCache) {
+			m_pathCache->Reset(m_navMesh->Get());
+		}
+		m_portalGraph.reset();
+		m_landmarks.reset();
+		m_randomPoints.Reset();
+	}
+
+	// Draws from the cumulative area table. The tiles of a streamed mesh come
+	// and go without a version bump, so there the resident tiles are walked
+	// like dtNavMeshQuery::findRandomPoint does. Callers hold a ResidentScope.
+	dtStatus RandomPoint(const dtQueryFilter *filter, dtPolyRef *randomRef, float *randomPt) {
+		if (m_navMesh->GetStreamer()) {
+			currentGenerator = &m_random;
+			return m_context.navQuery->findRandomPoint(filter, CurrentGeneratorFloat, randomRef, randomPt);
+		}
+		m_randomPoints.Update(m_navMesh->Get(), m_navMesh->GetVersion(), filter, HashQueryFilter(filter));
+		return m_randomPoints.Sample(m_context.navQuery, m_random, randomRef, randomPt);
+	}
+
+	// Workers keep their own reference to the mesh they were queued with, so
+	// load, clear and attach never free a mesh that is still being searched.
+	inline SharedNavMesh *GetSharedNavMesh() const {
+		return m_navMesh;
+	}
+
+	inline int GetMaxNodes() const {
+		return m_maxNodes;
+	}
+
+	inline int GetMaxPath() const {
+		return m_maxPath;
+	}
+
+	inline const dtQueryFilter &GetFilter() const {
+		return m_filter;
+	}
+
+	// NULL unless created with { pathCache }.
+	inline PathCache *GetPathCache() const {
+		return m_pathCache;
+	}
+
+	// Empty until buildPortalGraph.
+	inline std::shared_ptr<const PortalGraph> GetPortalGraph() const {
+		return m_portalGraph;
+	}
+
+	// Empty until buildLandmarks or loadLandmarks.
+	inline std::shared_ptr<const LandmarkTable> GetLandmarks() const {
+		return m_landmarks;
+	}
+
+	// Set when created with { bidirectional: true }.
+	inline bool IsBidirectional() const {
+		return m_bidirectional;
+	}
+
+	// NULL unless created with { stats: true }.
+	inline QueryStats *GetStats() const {
+		return m_stats;
+	}
+
+	// Called from the threadpool.
+	QueryContext *AcquireWorkerContext(const dtNavMesh *navMesh, int maxNodes, int maxPath) {
+		QueryContext *context = NULL;
+		uv_mutex_lock(&m_workerMutex);
+		if (!m_workerContexts.empty()) {
+			context = m_workerContexts.back();
+			m_workerContexts.pop_back();
+		}
+		uv_mutex_unlock(&m_workerMutex);
+		if (!context) {
+			context = new QueryContext();
+		}
+		if (dtStatusFailed(context->Init(navMesh, maxNodes, maxPath, m_openList))) {
+			delete context;
+			return NULL;
+		}
+		return context;
+	}
+
+	void ReleaseWorkerContext(QueryContext *context) {
+		uv_mutex_lock(&m_workerMutex);
+		m_workerContexts.push_back(context);
+		uv_mutex_unlock(&m_workerMutex);
+	}
+
 	static NAN_METHOD(New) {
 		if (info.IsConstructCall()) {
-			NavQuery *thisObject = new NavQuery();
+			int maxNodes = DEFAULT_MAX_NODES;
+			int maxPath = DEFAULT_MAX_PATH;
+			if (!ReadQueryOptions(info[0], &maxNodes, &maxPath)) {
+				return;
+			}
+			// { pathCache: entries } memoizes findPath corridors, see PathCache.
+			int pathCacheSize = 0;
+			if (info[0]->IsObject()) {
+				v8::Local<v8::Value> pathCacheValue = Nan::Get(info[0].As<v8::Object>(), Nan::New("pathCache").ToLocalChecked()).ToLocalChecked();
+				if (!pathCacheValue->IsUndefined()) {
+					pathCacheSize = Nan::To<int>(pathCacheValue).FromJust();
+					if (pathCacheSize < 0) {
+						Nan::ThrowRangeError("The \"pathCache\" option must be a non-negative integer");
+						return;
+					}
+				}
+			}
+			// { seed } makes findRandomPoint reproducible.
+			unsigned long long seed = uv_hrtime();
+			if (info[0]->IsObject()) {
+				v8::Local<v8::Value> seedValue = Nan::Get(info[0].As<v8::Object>(), Nan::New("seed").ToLocalChecked()).ToLocalChecked();
+				if (!seedValue->IsUndefined()) {
+					seed = (unsigned long long)Nan::To<int64_t>(seedValue).FromJust();
+				}
+			}
+			// { bidirectional: true } runs flat path searches from both ends.
+			bool bidirectional = false;
+			if (info[0]->IsObject()) {
+				bidirectional = Nan::To<bool>(Nan::Get(info[0].As<v8::Object>(), Nan::New("bidirectional").ToLocalChecked()).ToLocalChecked()).FromJust();
+			}
+			// { openList: 'quaternary' } searches with a 4-ary heap instead of
+			// the binary one, see dtNodeQueueType.
+			dtNodeQueueType openList = DT_NODE_QUEUE_BINARY_HEAP;
+			if (info[0]->IsObject()) {
+				v8::Local<v8::Value> openListValue = Nan::Get(info[0].As<v8::Object>(), Nan::New("openList").ToLocalChecked()).ToLocalChecked();
+				if (!openListValue->IsUndefined()) {
+					Nan::Utf8String openListName(openListValue);
+					if (strcmp(*openListName, "quaternary") == 0) {
+						openList = DT_NODE_QUEUE_QUATERNARY_HEAP;
+					} else if (strcmp(*openListName, "binary") != 0) {
+						Nan::ThrowRangeError("The \"openList\" option must be \"binary\" or \"quaternary\"");
+						return;
+					}
+				}
+			}
+			// { stats: true } counts calls, search effort and wall time per API.
+			bool stats = false;
+			if (info[0]->IsObject()) {
+				stats = Nan::To<bool>(Nan::Get(info[0].As<v8::Object>(), Nan::New("stats").ToLocalChecked()).ToLocalChecked()).FromJust();
+			}
+			NavQuery *thisObject = new NavQuery(maxNodes, maxPath, pathCacheSize, bidirectional, openList, stats, seed);
 			thisObject->Wrap(info.This());
 			info.GetReturnValue().Set(info.This());
 		}
@@ -53,7 +979,14 @@ public:
 		float nearestPt[3];
 		dtPolyRef nearestRef = 0;
 		dtStatus status = 0;
-		status = thisObject->m_navQuery->findNearestPoly(center, halfExtents, &thisObject->m_filter, &nearestRef, nearestPt);
+		float bmin[3];
+		float bmax[3];
+		dtVsub(bmin, center, halfExtents);
+		dtVadd(bmax, center, halfExtents);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_NEAREST_POLY, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+		status = thisObject->m_context.navQuery->findNearestPoly(center, halfExtents, GetQueryFilter(info, 6, &thisObject->m_filter), &nearestRef, nearestPt);
+		statsScope.AddStatus(status);
 		if (dtStatusFailed(status)) {
 			info.GetReturnValue().Set(Nan::New(status));
 			return;
@@ -70,12 +1003,88 @@ public:
 		info.GetReturnValue().Set(result);
 	}
 	
+	// findNearestPolyBatch(positions, extents, outRefs, outPoints[, useHint][, filter])
+	// snaps N packed x,y,z positions in one call. extents holds one x,y,z
+	// half extent shared by all positions or one per position. With useHint
+	// true the ref already in outRefs[i], e.g. from the previous tick, is kept
+	// when the position is still over that polygon within the vertical extent,
+	// and only otherwise is the BV tree queried. Positions with no polygon get
+	// ref 0 and their input position. Returns the number of positions snapped.
+	static NAN_METHOD(FindNearestPolyBatch) {
+		Isolate *isolate = info.GetIsolate();
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsFloat32Array() || !info[1]->IsFloat32Array() || !info[2]->IsUint32Array() || !info[3]->IsFloat32Array()) {
+			isolate->ThrowException(Nan::Error("Expected (Float32Array positions, Float32Array extents, Uint32Array outRefs, Float32Array outPoints[, useHint][, filter])"));
+			return;
+		}
+		Nan::TypedArrayContents<float> positions(info[0]);
+		Nan::TypedArrayContents<float> extents(info[1]);
+		Nan::TypedArrayContents<unsigned int> outRefs(info[2]);
+		Nan::TypedArrayContents<float> outPoints(info[3]);
+		const size_t count = positions.length() / 3;
+		if (outRefs.length() < count || outPoints.length() < count * 3) {
+			isolate->ThrowException(Nan::Error("The \"outRefs\" and \"outPoints\" arrays must hold 1 and 3 values per position"));
+			return;
+		}
+		if (extents.length() != 3 && extents.length() < count * 3) {
+			isolate->ThrowException(Nan::Error("The \"extents\" array must hold 3 floats or 3 floats per position"));
+			return;
+		}
+		// Only a boolean, a filter may be passed in its place.
+		const bool useHint = info[4]->IsBoolean() && info[4]->IsTrue();
+		const size_t extentsStride = extents.length() == 3 ? 0 : 3;
+		const dtNavMeshQuery *navQuery = thisObject->m_context.navQuery;
+		const dtQueryFilter *filter = GetQueryFilter(info, 4, &thisObject->m_filter);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_NEAREST_POLY_BATCH, navQuery);
+		int found = 0;
+		for (size_t index = 0; index < count; index++) {
+			const float *pos = &(*positions)[index * 3];
+			const float *halfExtents = &(*extents)[index * extentsStride];
+			float *nearestPt = &(*outPoints)[index * 3];
+			dtPolyRef nearestRef = useHint ? (*outRefs)[index] : 0;
+			float bmin[3];
+			float bmax[3];
+			dtVsub(bmin, pos, halfExtents);
+			dtVadd(bmax, pos, halfExtents);
+			ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+			if (nearestRef) {
+				bool posOverPoly = false;
+				if (!navQuery->isValidPolyRef(nearestRef, filter)
+					|| dtStatusFailed(navQuery->closestPointOnPoly(nearestRef, pos, nearestPt, &posOverPoly))
+					|| !posOverPoly || dtAbs(nearestPt[1] - pos[1]) > halfExtents[1]) {
+					nearestRef = 0;
+				}
+			}
+			if (!nearestRef) {
+				if (dtStatusFailed(navQuery->findNearestPoly(pos, halfExtents, filter, &nearestRef, nearestPt))) {
+					nearestRef = 0;
+				}
+			}
+			if (!nearestRef) {
+				dtVcopy(nearestPt, pos);
+			} else {
+				found++;
+			}
+			(*outRefs)[index] = nearestRef;
+		}
+		info.GetReturnValue().Set(Nan::New(found));
+	}
+
+	// seed(value) restarts the random point sequence of this query.
+	static NAN_METHOD(Seed) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		thisObject->m_random.Seed((unsigned long long)Nan::To<int64_t>(info[0]).FromJust());
+	}
+
 	static NAN_METHOD(FindRandomPoint) {
 		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
 		dtPolyRef randomRef;
 		float randomPt[3];
 		dtStatus status = 0;
-		status = thisObject->m_navQuery->findRandomPoint(&thisObject->m_filter, frand, &randomRef, randomPt);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_RANDOM_POINT, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, NULL, NULL, false);
+		status = thisObject->RandomPoint(GetQueryFilter(info, 0, &thisObject->m_filter), &randomRef, randomPt);
+		statsScope.AddStatus(status);
 		if (dtStatusFailed(status)) {
 			info.GetReturnValue().Set(Nan::New(status));
 			return;
@@ -87,6 +1096,42 @@ public:
 		Nan::Set(result, Nan::New("ref").ToLocalChecked(), Nan::New(randomRef));
 		info.GetReturnValue().Set(result);
 	}
+
+	// findRandomPoints(n, outPoints[, outRefs]) writes n packed x,y,z points,
+	// and their refs to outRefs when given. The area table is built on the
+	// first call and reused until the mesh, its flags or the filter change,
+	// so each point costs a binary search. Returns the number of points
+	// written, which is only short of n when no poly passes the filter.
+	static NAN_METHOD(FindRandomPoints) {
+		Isolate *isolate = info.GetIsolate();
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsNumber() || !info[1]->IsFloat32Array() || (!info[2]->IsUndefined() && !info[2]->IsUint32Array() && !QueryFilter::HasInstance(info[2]))) {
+			isolate->ThrowException(Nan::Error("Expected (number n, Float32Array outPoints[, Uint32Array outRefs])"));
+			return;
+		}
+		const int64_t count = Nan::To<int64_t>(info[0]).FromJust();
+		Nan::TypedArrayContents<float> outPoints(info[1]);
+		const bool hasRefs = info[2]->IsUint32Array();
+		Nan::TypedArrayContents<unsigned int> outRefs(hasRefs ? info[2] : v8::Local<v8::Value>(Nan::Undefined()));
+		if (count < 0 || outPoints.length() < (size_t)count * 3 || (hasRefs && outRefs.length() < (size_t)count)) {
+			Nan::ThrowRangeError("The \"outPoints\" and \"outRefs\" arrays must hold 3 and 1 values per point");
+			return;
+		}
+		const dtQueryFilter *filter = GetQueryFilter(info, 2, &thisObject->m_filter);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_RANDOM_POINTS, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, NULL, NULL, false);
+		int64_t written = 0;
+		for (; written < count; written++) {
+			dtPolyRef randomRef = 0;
+			if (dtStatusFailed(thisObject->RandomPoint(filter, &randomRef, &(*outPoints)[written * 3]))) {
+				break;
+			}
+			if (hasRefs) {
+				(*outRefs)[written] = randomRef;
+			}
+		}
+		info.GetReturnValue().Set(Nan::New<v8::Number>((double)written));
+	}
 	
 	static NAN_METHOD(FindStraightPath) {
 		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
@@ -94,58 +1139,419 @@ public:
 			info.GetReturnValue().Set(Nan::New(0));
 			return;
 		}
-		v8::Local<v8::Object> startObject = Nan::To<v8::Object>(info[0]).ToLocalChecked();
-		v8::Local<v8::Object> endObject = Nan::To<v8::Object>(info[1]).ToLocalChecked();
-		dtPolyRef startRef = (int)Nan::To<int>(Nan::Get(startObject, Nan::New("ref").ToLocalChecked()).ToLocalChecked()).FromJust();
-		dtPolyRef endRef = (int)Nan::To<int>(Nan::Get(endObject, Nan::New("ref").ToLocalChecked()).ToLocalChecked()).FromJust();
-		const float startPos[] = {
-			(float)Nan::To<double>(Nan::Get(startObject, Nan::New("x").ToLocalChecked()).ToLocalChecked()).FromJust(),
-			(float)Nan::To<double>(Nan::Get(startObject, Nan::New("y").ToLocalChecked()).ToLocalChecked()).FromJust(),
-			(float)Nan::To<double>(Nan::Get(startObject, Nan::New("z").ToLocalChecked()).ToLocalChecked()).FromJust(),
-		};
-		const float endPos[] = {
-			(float)Nan::To<double>(Nan::Get(endObject, Nan::New("x").ToLocalChecked()).ToLocalChecked()).FromJust(),
-			(float)Nan::To<double>(Nan::Get(endObject, Nan::New("y").ToLocalChecked()).ToLocalChecked()).FromJust(),
-			(float)Nan::To<double>(Nan::Get(endObject, Nan::New("z").ToLocalChecked()).ToLocalChecked()).FromJust(),
-		};
-		const int maxPath = 2048;
-		dtPolyRef path[maxPath];
+		dtPolyRef startRef = 0;
+		dtPolyRef endRef = 0;
+		float startPos[3];
+		float endPos[3];
+		ReadPosition(info[0], startPos, &startRef);
+		ReadPosition(info[1], endPos, &endRef);
+		float bmin[3];
+		float bmax[3];
+		PathBounds(startPos, endPos, bmin, bmax);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_STRAIGHT_PATH, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, true);
+		QueryContext &context = thisObject->m_context;
+		dtPolyRef *path = &context.path[0];
 		int pathCount = 0;
-		float straightPath[maxPath * 3];
-		unsigned char straightPathFlags[maxPath];
-		dtPolyRef straightPathRefs[maxPath];
-		int straightPathCount = 0;
 		dtStatus status = 0;
-		status = thisObject->m_navQuery->findPath(startRef, endRef, startPos, endPos, &thisObject->m_filter, path, &pathCount, maxPath);
+		status = CachedFindPath(thisObject->m_pathCache, thisObject->m_portalGraph.get(), thisObject->m_landmarks.get(), thisObject->m_bidirectional, thisObject->m_navMesh, context.navQuery, residentScope, startRef, endRef, startPos, endPos, GetQueryFilter(info, 2, &thisObject->m_filter), path, &pathCount, context.GetMaxPath());
+		statsScope.AddStatus(status);
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+			return;
+		}
+		SetStraightPathResult(info, 2, context, startPos, endPos, path, pathCount);
+	}
+
+	static NAN_METHOD(FindStraightPathAsync);
+
+	static NAN_METHOD(CreatePathJob);
+
+	static NAN_METHOD(CreatePathQueue);
+
+	// findStraightPathBatch(starts, ends, refs) resolves N paths in one call.
+	// starts and ends hold N packed x,y,z positions, refs holds N startRef,endRef
+	// pairs. Corners of path i are points[offsets[i]*3 .. offsets[i+1]*3).
+	static NAN_METHOD(FindStraightPathBatch) {
+		Isolate *isolate = info.GetIsolate();
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsFloat32Array() || !info[1]->IsFloat32Array() || !info[2]->IsUint32Array()) {
+			isolate->ThrowException(Nan::Error("Expected (Float32Array starts, Float32Array ends, Uint32Array refs)"));
+			return;
+		}
+		Nan::TypedArrayContents<float> starts(info[0]);
+		Nan::TypedArrayContents<float> ends(info[1]);
+		Nan::TypedArrayContents<unsigned int> refs(info[2]);
+		const size_t count = refs.length() / 2;
+		if (starts.length() < count * 3 || ends.length() < count * 3) {
+			isolate->ThrowException(Nan::Error("The \"starts\" and \"ends\" arrays must hold 3 floats per path"));
+			return;
+		}
+		QueryContext &context = thisObject->m_context;
+		const dtQueryFilter *filter = GetQueryFilter(info, 3, &thisObject->m_filter);
+		const int maxPath = context.GetMaxPath();
+		const float *straightPath = &context.straightPath[0];
+		const unsigned char *straightPathFlags = &context.straightPathFlags[0];
+		const dtPolyRef *straightPathRefs = &context.straightPathRefs[0];
+		int pathCount = 0;
+		int straightPathCount = 0;
+		std::vector<float> points;
+		std::vector<unsigned int> pointRefs;
+		std::vector<unsigned char> pointFlags;
+		std::vector<unsigned int> offsets(count + 1, 0);
+		std::vector<unsigned int> statuses(count, 0);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_STRAIGHT_PATH_BATCH, context.navQuery);
+		for (size_t index = 0; index < count; index++) {
+			const float *startPos = &(*starts)[index * 3];
+			const float *endPos = &(*ends)[index * 3];
+			float bmin[3];
+			float bmax[3];
+			PathBounds(startPos, endPos, bmin, bmax);
+			ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, true);
+			dtStatus status = CachedFindPath(thisObject->m_pathCache, thisObject->m_portalGraph.get(), thisObject->m_landmarks.get(), thisObject->m_bidirectional, thisObject->m_navMesh, context.navQuery, residentScope, (*refs)[index * 2 + 0], (*refs)[index * 2 + 1], startPos, endPos, filter, &context.path[0], &pathCount, maxPath);
+			statsScope.AddStatus(status);
+			straightPathCount = 0;
+			if (!dtStatusFailed(status)) {
+				status = context.navQuery->findStraightPath(startPos, endPos, &context.path[0], pathCount, &context.straightPath[0], &context.straightPathFlags[0], &context.straightPathRefs[0], &straightPathCount, maxPath, 0);
+			}
+			statuses[index] = status;
+			if (!dtStatusFailed(status)) {
+				points.insert(points.end(), straightPath, straightPath + straightPathCount * 3);
+				pointRefs.insert(pointRefs.end(), straightPathRefs, straightPathRefs + straightPathCount);
+				pointFlags.insert(pointFlags.end(), straightPathFlags, straightPathFlags + straightPathCount);
+			}
+			offsets[index + 1] = (unsigned int)pointRefs.size();
+		}
+		v8::Local<v8::Object> result = Nan::New<v8::Object>();
+		Nan::Set(result, Nan::New("points").ToLocalChecked(), CopyToTypedArray<v8::Float32Array>(points.empty() ? NULL : &points[0], points.size()));
+		Nan::Set(result, Nan::New("refs").ToLocalChecked(), CopyToTypedArray<v8::Uint32Array>(pointRefs.empty() ? NULL : &pointRefs[0], pointRefs.size()));
+		Nan::Set(result, Nan::New("flags").ToLocalChecked(), CopyToTypedArray<v8::Uint8Array>(pointFlags.empty() ? NULL : &pointFlags[0], pointFlags.size()));
+		Nan::Set(result, Nan::New("offsets").ToLocalChecked(), CopyToTypedArray<v8::Uint32Array>(&offsets[0], offsets.size()));
+		Nan::Set(result, Nan::New("status").ToLocalChecked(), CopyToTypedArray<v8::Uint32Array>(statuses.empty() ? NULL : &statuses[0], statuses.size()));
+		info.GetReturnValue().Set(result);
+	}
+
+	// raycast(start, end, hit[, visited][, options]) casts a walkability ray
+	// from start {x,y,z,ref} toward end {x,y,z}. hit (Float32Array) receives
+	// t, the wall normal and, when long enough, the hit edge index and the
+	// path cost. t is FLT_MAX when no wall was hit. Visited polygons go into
+	// the optional Uint32Array and their count is returned.
+	static NAN_METHOD(Raycast) {
+		Isolate *isolate = info.GetIsolate();
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsObject() || !info[1]->IsObject() || !info[2]->IsFloat32Array()) {
+			isolate->ThrowException(Nan::Error("Expected (start, end, Float32Array hit[, Uint32Array visited][, options])"));
+			return;
+		}
+		Nan::TypedArrayContents<float> out(info[2]);
+		if (out.length() < 4) {
+			isolate->ThrowException(Nan::Error("The \"hit\" array must hold at least 4 floats"));
+			return;
+		}
+		dtPolyRef startRef = 0;
+		float startPos[3];
+		float endPos[3];
+		ReadPosition(info[0], startPos, &startRef);
+		ReadPosition(info[1], endPos, NULL);
+		dtRaycastHit hit;
+		memset(&hit, 0, sizeof(hit));
+		int argc = 3;
+		if (info[argc]->IsUint32Array()) {
+			Nan::TypedArrayContents<unsigned int> visited(info[argc++]);
+			hit.path = *visited;
+			hit.maxPath = (int)visited.length();
+		}
+		unsigned int options = 0;
+		if (info[argc]->IsNumber()) {
+			options = Nan::To<uint32_t>(info[argc]).FromJust();
+		}
+		float bmin[3];
+		float bmax[3];
+		PathBounds(startPos, endPos, bmin, bmax);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_RAYCAST, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+		dtStatus status = thisObject->m_context.navQuery->raycast(startRef, startPos, endPos, GetQueryFilter(info, 3, &thisObject->m_filter), options, &hit);
+		statsScope.AddStatus(status);
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+			return;
+		}
+		(*out)[0] = hit.t;
+		dtVcopy(&(*out)[1], hit.hitNormal);
+		if (out.length() >= 6) {
+			(*out)[4] = (float)hit.hitEdgeIndex;
+			(*out)[5] = hit.pathCost;
+		}
+		info.GetReturnValue().Set(Nan::New(hit.pathCount));
+	}
+
+	// moveAlongSurface(start, end, position[, visited]) slides from start
+	// {x,y,z,ref} toward end {x,y,z} and writes where the mover ends up into
+	// position (Float32Array of 3). Returns the number of visited polygons,
+	// which are written to the optional Uint32Array.
+	static NAN_METHOD(MoveAlongSurface) {
+		Isolate *isolate = info.GetIsolate();
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsObject() || !info[1]->IsObject() || !info[2]->IsFloat32Array()) {
+			isolate->ThrowException(Nan::Error("Expected (start, end, Float32Array position[, Uint32Array visited])"));
+			return;
+		}
+		Nan::TypedArrayContents<float> out(info[2]);
+		if (out.length() < 3) {
+			isolate->ThrowException(Nan::Error("The \"position\" array must hold at least 3 floats"));
+			return;
+		}
+		dtPolyRef startRef = 0;
+		float startPos[3];
+		float endPos[3];
+		ReadPosition(info[0], startPos, &startRef);
+		ReadPosition(info[1], endPos, NULL);
+		QueryContext &context = thisObject->m_context;
+		dtPolyRef *visited = &context.path[0];
+		int maxVisited = context.GetMaxPath();
+		if (info[3]->IsUint32Array()) {
+			Nan::TypedArrayContents<unsigned int> visitedContents(info[3]);
+			visited = *visitedContents;
+			maxVisited = (int)visitedContents.length();
+		}
+		int visitedCount = 0;
+		float bmin[3];
+		float bmax[3];
+		PathBounds(startPos, endPos, bmin, bmax);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_MOVE_ALONG_SURFACE, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+		dtStatus status = context.navQuery->moveAlongSurface(startRef, startPos, endPos, GetQueryFilter(info, 3, &thisObject->m_filter), *out, visited, &visitedCount, maxVisited);
+		statsScope.AddStatus(status);
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+			return;
+		}
+		info.GetReturnValue().Set(Nan::New(visitedCount));
+	}
+
+	// findDistanceToWall(center, maxRadius, hit) writes the distance, the wall
+	// position and the normal from the wall toward center into hit
+	// (Float32Array of 7) and returns the distance.
+	static NAN_METHOD(FindDistanceToWall) {
+		Isolate *isolate = info.GetIsolate();
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsObject() || !info[2]->IsFloat32Array()) {
+			isolate->ThrowException(Nan::Error("Expected (center, maxRadius, Float32Array hit)"));
+			return;
+		}
+		Nan::TypedArrayContents<float> out(info[2]);
+		if (out.length() < 7) {
+			isolate->ThrowException(Nan::Error("The \"hit\" array must hold at least 7 floats"));
+			return;
+		}
+		dtPolyRef centerRef = 0;
+		float centerPos[3];
+		ReadPosition(info[0], centerPos, &centerRef);
+		const float maxRadius = (float)Nan::To<double>(info[1]).FromJust();
+		const float extents[3] = { maxRadius, maxRadius, maxRadius };
+		float bmin[3];
+		float bmax[3];
+		dtVsub(bmin, centerPos, extents);
+		dtVadd(bmax, centerPos, extents);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_DISTANCE_TO_WALL, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+		float *hit = *out;
+		dtStatus status = thisObject->m_context.navQuery->findDistanceToWall(centerRef, centerPos, maxRadius, GetQueryFilter(info, 3, &thisObject->m_filter), &hit[0], &hit[1], &hit[4]);
+		statsScope.AddStatus(status);
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+			return;
+		}
+		info.GetReturnValue().Set(Nan::New(hit[0]));
+	}
+
+	// findRandomPointAroundCircle(center, maxRadius, point) writes a point
+	// reachable from center {x,y,z,ref} into point (Float32Array of 3) and
+	// returns its ref. Uses the generator of this query, see seed.
+	static NAN_METHOD(FindRandomPointAroundCircle) {
+		Isolate *isolate = info.GetIsolate();
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsObject() || !info[2]->IsFloat32Array()) {
+			isolate->ThrowException(Nan::Error("Expected (center, maxRadius, Float32Array point)"));
+			return;
+		}
+		Nan::TypedArrayContents<float> out(info[2]);
+		if (out.length() < 3) {
+			isolate->ThrowException(Nan::Error("The \"point\" array must hold at least 3 floats"));
+			return;
+		}
+		dtPolyRef centerRef = 0;
+		float centerPos[3];
+		ReadPosition(info[0], centerPos, &centerRef);
+		const float maxRadius = (float)Nan::To<double>(info[1]).FromJust();
+		const float extents[3] = { maxRadius, maxRadius, maxRadius };
+		float bmin[3];
+		float bmax[3];
+		dtVsub(bmin, centerPos, extents);
+		dtVadd(bmax, centerPos, extents);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_RANDOM_POINT_AROUND_CIRCLE, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+		currentGenerator = &thisObject->m_random;
+		dtPolyRef randomRef = 0;
+		dtStatus status = thisObject->m_context.navQuery->findRandomPointAroundCircle(centerRef, centerPos, maxRadius, GetQueryFilter(info, 3, &thisObject->m_filter), CurrentGeneratorFloat, &randomRef, *out);
+		statsScope.AddStatus(status);
 		if (dtStatusFailed(status)) {
 			info.GetReturnValue().Set(Nan::New(status));
 			return;
 		}
-		status = thisObject->m_navQuery->findStraightPath(startPos, endPos, path, pathCount, straightPath, straightPathFlags, straightPathRefs, &straightPathCount, maxPath, 0);
-		if (dtStatusFailed(status)) {
-			info.GetReturnValue().Set(Nan::New(status));
+		info.GetReturnValue().Set(Nan::New(randomRef));
+	}
+
+	// Shared by the circle searches: reads (center, radius, Uint32Array refs
+	// [, Uint32Array parents][, Float32Array costs][, maxResult]) from info.
+	// At most maxResult polygons, or as many as every given array holds, are
+	// written. Throws and returns false on bad arguments.
+	struct CircleSearch {
+		dtPolyRef centerRef;
+		float centerPos[3];
+		float radius;
+		dtPolyRef *refs;
+		dtPolyRef *parents;
+		float *costs;
+		int maxResult;
+		int filterIndex;
+	};
+
+	static bool ReadCircleSearch(Nan::NAN_METHOD_ARGS_TYPE info, bool withCosts, const char *usage, CircleSearch *search) {
+		Isolate *isolate = info.GetIsolate();
+		if (!info[0]->IsObject() || !info[2]->IsUint32Array()) {
+			isolate->ThrowException(Nan::Error(usage));
+			return false;
+		}
+		search->centerRef = 0;
+		ReadPosition(info[0], search->centerPos, &search->centerRef);
+		search->radius = (float)Nan::To<double>(info[1]).FromJust();
+		Nan::TypedArrayContents<unsigned int> refs(info[2]);
+		search->refs = *refs;
+		search->parents = NULL;
+		search->costs = NULL;
+		size_t capacity = refs.length();
+		int argc = 3;
+		if (info[argc]->IsUint32Array()) {
+			Nan::TypedArrayContents<unsigned int> parents(info[argc++]);
+			search->parents = *parents;
+			capacity = std::min(capacity, parents.length());
+		}
+		if (withCosts && info[argc]->IsFloat32Array()) {
+			Nan::TypedArrayContents<float> costs(info[argc++]);
+			search->costs = *costs;
+			capacity = std::min(capacity, costs.length());
+		}
+		search->maxResult = (int)std::min(capacity, (size_t)INT_MAX);
+		if (info[argc]->IsNumber()) {
+			int maxResult = Nan::To<int>(info[argc++]).FromJust();
+			if (maxResult < 0 || maxResult > search->maxResult) {
+				Nan::ThrowRangeError("The \"maxResult\" argument must be between 0 and the length of the result arrays");
+				return false;
+			}
+			search->maxResult = maxResult;
+		}
+		search->filterIndex = argc;
+		return true;
+	}
+
+	// findPolysAroundCircle(center, radius, refs[, parents][, costs]
+	// [, maxResult]) runs a Dijkstra search from center {x,y,z,ref} over the
+	// polygons touching the circle and writes them, the polygon each was
+	// reached from and the path cost to it into the preallocated arrays.
+	// Returns the number of polygons written.
+	static NAN_METHOD(FindPolysAroundCircle) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		CircleSearch search;
+		if (!ReadCircleSearch(info, true, "Expected (center, radius, Uint32Array refs[, Uint32Array parents][, Float32Array costs][, maxResult])", &search)) {
+			return;
+		}
+		const float extents[3] = { search.radius, search.radius, search.radius };
+		float bmin[3];
+		float bmax[3];
+		dtVsub(bmin, search.centerPos, extents);
+		dtVadd(bmax, search.centerPos, extents);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_POLYS_AROUND_CIRCLE, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+		int resultCount = 0;
+		dtStatus status = thisObject->m_context.navQuery->findPolysAroundCircle(search.centerRef, search.centerPos, search.radius, GetQueryFilter(info, search.filterIndex, &thisObject->m_filter),
+			search.refs, search.parents, search.costs, &resultCount, search.maxResult);
+		statsScope.AddStatus(status);
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+			return;
+		}
+		info.GetReturnValue().Set(Nan::New(resultCount));
+	}
+
+	// findLocalNeighbourhood(center, radius, refs[, parents][, maxResult])
+	// writes the non-overlapping polygons around center {x,y,z,ref} within
+	// radius, as used for local steering, and returns their number.
+	static NAN_METHOD(FindLocalNeighbourhood) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		CircleSearch search;
+		if (!ReadCircleSearch(info, false, "Expected (center, radius, Uint32Array refs[, Uint32Array parents][, maxResult])", &search)) {
+			return;
+		}
+		const float extents[3] = { search.radius, search.radius, search.radius };
+		float bmin[3];
+		float bmax[3];
+		dtVsub(bmin, search.centerPos, extents);
+		dtVadd(bmax, search.centerPos, extents);
+		QueryStatsScope statsScope(thisObject->m_stats, QUERY_STATS_FIND_LOCAL_NEIGHBOURHOOD, thisObject->m_context.navQuery);
+		ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, false);
+		int resultCount = 0;
+		dtStatus status = thisObject->m_context.navQuery->findLocalNeighbourhood(search.centerRef, search.centerPos, search.radius, GetQueryFilter(info, search.filterIndex, &thisObject->m_filter),
+			search.refs, search.parents, &resultCount, search.maxResult);
+		statsScope.AddStatus(status);
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+			return;
+		}
+		info.GetReturnValue().Set(Nan::New(resultCount));
+	}
+
+	static NAN_METHOD(Clear) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		thisObject->SetNavMesh(new SharedNavMesh(dtAllocNavMesh()), thisObject->m_maxNodes, thisObject->m_maxPath);
+		info.GetReturnValue().Set(Nan::True());
+	}
+
+	// attach(navMesh[, options]) shares the mesh of a NavMesh object, or of a
+	// share() handle posted from another thread. The query keeps its own
+	// dtNavMeshQuery and filter.
+	static NAN_METHOD(Attach) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!NavMesh::HasInstance(info[0]) && !info[0]->IsSharedArrayBuffer()) {
+			info.GetIsolate()->ThrowException(Nan::Error("The \"navMesh\" argument must be a NavMesh or a handle returned by share()"));
+			return;
+		}
+		int maxNodes = thisObject->m_maxNodes;
+		int maxPath = thisObject->m_maxPath;
+		if (!ReadQueryOptions(info[1], &maxNodes, &maxPath)) {
 			return;
 		}
-		v8::Local<v8::Array> result = Nan::New<v8::Array>(straightPathCount);
-		for (int index = 0; index < straightPathCount; index++) {
-			v8::Local<v8::Object> vector3 = Nan::New<v8::Object>();
-			const int cursor = index * 3;
-			Nan::Set(vector3, Nan::New("x").ToLocalChecked(), Nan::New(straightPath[cursor + 0]));
-			Nan::Set(vector3, Nan::New("y").ToLocalChecked(), Nan::New(straightPath[cursor + 1]));
-			Nan::Set(vector3, Nan::New("z").ToLocalChecked(), Nan::New(straightPath[cursor + 2]));
-			Nan::Set(vector3, Nan::New("ref").ToLocalChecked(), Nan::New(straightPathRefs[index]));
-			Nan::Set(vector3, Nan::New("flags").ToLocalChecked(), Nan::New(straightPathFlags[index]));
-			Nan::Set(result, index, vector3);
+		if (info[0]->IsSharedArrayBuffer()) {
+			SharedNavMesh *navMesh = ImportSharedNavMesh(info[0]);
+			if (!navMesh) {
+				info.GetIsolate()->ThrowException(Nan::Error("The \"navMesh\" argument must be a NavMesh or a handle returned by share()"));
+				return;
+			}
+			thisObject->SetNavMesh(navMesh, maxNodes, maxPath);
+			info.GetReturnValue().Set(Nan::True());
+			return;
 		}
-		info.GetReturnValue().Set(result);
+		NavMesh *navMesh = Nan::ObjectWrap::Unwrap<NavMesh>(Nan::To<v8::Object>(info[0]).ToLocalChecked());
+		navMesh->GetSharedNavMesh()->Ref();
+		thisObject->SetNavMesh(navMesh->GetSharedNavMesh(), maxNodes, maxPath);
+		Nan::Set(info.This(), Nan::New("filename").ToLocalChecked(), Nan::Get(info[0].As<v8::Object>(), Nan::New("filename").ToLocalChecked()).ToLocalChecked());
+		info.GetReturnValue().Set(Nan::True());
 	}
 
-	static NAN_METHOD(Clear) {
+	// share() returns a SharedArrayBuffer handle to the current mesh.
+	static NAN_METHOD(Share) {
 		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
-		dtFreeNavMesh(thisObject->m_navMesh);
-		thisObject->m_navMesh = dtAllocNavMesh();
-		thisObject->m_navQuery->init(thisObject->m_navMesh, 2048);
-		info.GetReturnValue().Set(Nan::True());
+		info.GetReturnValue().Set(ShareNavMesh(thisObject->m_navMesh));
 	}
 		
 	static NAN_METHOD(Load) {
@@ -155,75 +1561,201 @@ public:
 			isolate->ThrowException(Nan::Error("The \"path\" argument must be of type string"));
 			return;
 		}
+		int maxNodes = thisObject->m_maxNodes;
+		int maxPath = thisObject->m_maxPath;
+		LoadOptions loadOptions;
+		if (!ReadQueryOptions(info[1], &maxNodes, &maxPath) || !ReadLoadOptions(info[1], &loadOptions)) {
+			return;
+		}
 		char charBuffer[1024];
-		dtStatus status = 0;
-		dtNavMesh *navMesh = NULL;
 		Nan::Utf8String path(info[0]);
 
 		Nan::Set(info.This(), Nan::New("filename").ToLocalChecked(), info[0]);
-		
-		Sample sample;
-		navMesh = sample.loadAll(*path);
-		if (navMesh) {
-			dtFreeNavMesh(thisObject->m_navMesh);
-			thisObject->m_navMesh = navMesh;
-			thisObject->m_navQuery->init(thisObject->m_navMesh, 2048);
-			info.GetReturnValue().Set(Nan::True());
+
+		SharedNavMesh *navMesh = LoadNavMesh(*path, loadOptions, charBuffer, sizeof(charBuffer));
+		if (!navMesh) {
+			isolate->ThrowException(Nan::Error(charBuffer));
 			return;
 		}
+		thisObject->SetNavMesh(navMesh, maxNodes, maxPath);
+		info.GetReturnValue().Set(Nan::True());
+	}
+
+	static NAN_METHOD(LoadAsync);
 
-		FILE *fp = fopen(*path, "rb");
-		if (!fp) {
-			isolate->ThrowException(Nan::Error("No such file or directory"));
+	static NAN_METHOD(LoadFromBuffer) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		int maxNodes = thisObject->m_maxNodes;
+		int maxPath = thisObject->m_maxPath;
+		if (!ReadQueryOptions(info[1], &maxNodes, &maxPath)) {
 			return;
 		}
-		if (fseek(fp, 0, SEEK_END) != 0) {
-			fclose(fp);
-			isolate->ThrowException(Nan::Error("fseek"));
+		char charBuffer[1024];
+		SharedNavMesh *navMesh = LoadNavMeshBuffer(info[0], info[1], charBuffer, sizeof(charBuffer));
+		if (!navMesh) {
+			info.GetIsolate()->ThrowException(Nan::Error(charBuffer));
 			return;
 		}
-		long bufferSize = ftell(fp);
-		if (bufferSize < 0) {
-			fclose(fp);
-			isolate->ThrowException(Nan::Error("ftell"));
+		thisObject->SetNavMesh(navMesh, maxNodes, maxPath);
+		info.GetReturnValue().Set(Nan::True());
+	}
+
+	static NAN_METHOD(GetTileStats) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		info.GetReturnValue().Set(TileStatsToObject(thisObject->m_navMesh));
+	}
+
+	// setPolyFlags(ref, flags) changes the flags of a polygon of the mesh, for
+	// every NavQuery sharing it, and invalidates cached paths. Returns the
+	// dtStatus.
+	static NAN_METHOD(SetPolyFlags) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		dtPolyRef ref = Nan::To<uint32_t>(info[0]).FromJust();
+		unsigned short flags = (unsigned short)Nan::To<int>(info[1]).FromJust();
+		dtStatus status = thisObject->m_navMesh->Get()->setPolyFlags(ref, flags);
+		if (!dtStatusFailed(status)) {
+			thisObject->m_navMesh->BumpVersion();
+		}
+		info.GetReturnValue().Set(Nan::New(status));
+	}
+
+	static NAN_METHOD(GetPolyFlags) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		dtPolyRef ref = Nan::To<uint32_t>(info[0]).FromJust();
+		unsigned short flags = 0;
+		dtStatus status = thisObject->m_navMesh->Get()->getPolyFlags(ref, &flags);
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
 			return;
 		}
-		if (fseek(fp, 0, SEEK_SET) != 0) {
-			fclose(fp);
-			isolate->ThrowException(Nan::Error("fseek"));
+		info.GetReturnValue().Set(Nan::New(flags));
+	}
+
+	// Hit, miss and invalidation counts of the path cache, null when disabled.
+	static NAN_METHOD(GetPathCacheStats) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!thisObject->m_pathCache) {
+			info.GetReturnValue().Set(Nan::Null());
 			return;
 		}
-		unsigned char *buffer = (unsigned char*)dtAlloc(bufferSize, DT_ALLOC_PERM);
-		if (!buffer) {
-			fclose(fp);
-			isolate->ThrowException(Nan::Error("Out of Memory"));
+		PathCacheStats stats = thisObject->m_pathCache->GetStats();
+		v8::Local<v8::Object> result = Nan::New<v8::Object>();
+		Nan::Set(result, Nan::New("hits").ToLocalChecked(), Nan::New((double)stats.hits));
+		Nan::Set(result, Nan::New("misses").ToLocalChecked(), Nan::New((double)stats.misses));
+		Nan::Set(result, Nan::New("invalidations").ToLocalChecked(), Nan::New((double)stats.invalidations));
+		Nan::Set(result, Nan::New("size").ToLocalChecked(), Nan::New(stats.size));
+		info.GetReturnValue().Set(result);
+	}
+
+	// getStats() returns, per API called so far, { count, nodes, pushes,
+	// outOfNodes, partialResults, failures, totalMicros, maxMicros,
+	// histogram }, or null unless created with { stats: true }. nodes and
+	// pushes are dtNodePool allocations and open list pushes. histogram is a
+	// Uint32Array: bucket 0 counts calls under 1 microsecond, bucket i calls
+	// from 2^(i-1) up to 2^i microseconds, the last one all slower calls.
+	static NAN_METHOD(GetStats) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!thisObject->m_stats) {
+			info.GetReturnValue().Set(Nan::Null());
 			return;
 		}
-		size_t readSize = fread(buffer, bufferSize, 1, fp);
-		fclose(fp);
-		if (readSize != 1) {
-			dtFree(buffer);
-			isolate->ThrowException(Nan::Error("fread"));
+		QueryStatsEntry entries[QUERY_STATS_API_COUNT];
+		thisObject->m_stats->Snapshot(entries);
+		v8::Local<v8::Object> result = Nan::New<v8::Object>();
+		for (int api = 0; api < QUERY_STATS_API_COUNT; api++) {
+			const QueryStatsEntry &entry = entries[api];
+			if (!entry.count) {
+				continue;
+			}
+			v8::Local<v8::Object> item = Nan::New<v8::Object>();
+			Nan::Set(item, Nan::New("count").ToLocalChecked(), Nan::New((double)entry.count));
+			Nan::Set(item, Nan::New("nodes").ToLocalChecked(), Nan::New((double)entry.nodes));
+			Nan::Set(item, Nan::New("pushes").ToLocalChecked(), Nan::New((double)entry.pushes));
+			Nan::Set(item, Nan::New("outOfNodes").ToLocalChecked(), Nan::New((double)entry.outOfNodes));
+			Nan::Set(item, Nan::New("partialResults").ToLocalChecked(), Nan::New((double)entry.partialResults));
+			Nan::Set(item, Nan::New("failures").ToLocalChecked(), Nan::New((double)entry.failures));
+			Nan::Set(item, Nan::New("totalMicros").ToLocalChecked(), Nan::New(entry.totalNanos / 1000.0));
+			Nan::Set(item, Nan::New("maxMicros").ToLocalChecked(), Nan::New(entry.maxNanos / 1000.0));
+			Nan::Set(item, Nan::New("histogram").ToLocalChecked(), CopyToTypedArray<v8::Uint32Array>(entry.histogram, QUERY_STATS_BUCKETS));
+			Nan::Set(result, Nan::New(QueryStats::GetApiName((QueryStatsApi)api)).ToLocalChecked(), item);
+		}
+		info.GetReturnValue().Set(result);
+	}
+
+	// buildPortalGraph([filter]) precomputes the graph between tile borders
+	// that findStraightPath, findStraightPathBatch and findStraightPathAsync
+	// then search first when their end points lie two or more tiles apart,
+	// see PortalGraph. It is built for the flags of the mesh and the filter
+	// as they are now, searches with another filter or after setPolyFlags
+	// run flat until it is built again. The abstract search pays off on meshes
+	// with large tiles; where tiles hold a few polygons each, like the test
+	// mesh, a flat search is faster. Returns { nodes, edges }.
+	static NAN_METHOD(BuildPortalGraph) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (thisObject->m_navMesh->GetStreamer()) {
+			info.GetIsolate()->ThrowException(Nan::Error("A portal graph needs every tile, it can not be built for a streamed mesh"));
 			return;
 		}
-		navMesh = dtAllocNavMesh();
-		if (!navMesh) {
-			dtFree(buffer);
-			isolate->ThrowException(Nan::Error("dtAllocNavMesh"));
+		const dtQueryFilter *filter = GetQueryFilter(info, 0, &thisObject->m_filter);
+		PortalGraph *portalGraph = new PortalGraph();
+		portalGraph->Build(thisObject->m_navMesh->Get(), thisObject->m_navMesh->GetVersion(), filter, HashQueryFilter(filter));
+		thisObject->m_portalGraph.reset(portalGraph);
+		v8::Local<v8::Object> result = Nan::New<v8::Object>();
+		Nan::Set(result, Nan::New("nodes").ToLocalChecked(), Nan::New(portalGraph->GetNodeCount()));
+		Nan::Set(result, Nan::New("edges").ToLocalChecked(), Nan::New(portalGraph->GetEdgeCount()));
+		info.GetReturnValue().Set(result);
+	}
+
+	// buildLandmarks(count[, filter]) picks count landmark polygons and
+	// records the cost from each to every polygon, see LandmarkTable. Path
+	// searches with the filter then use them to bound their heuristic, until
+	// setPolyFlags. Returns the table as a Uint8Array to store alongside the
+	// navmesh file and hand to loadLandmarks later.
+	static NAN_METHOD(BuildLandmarks) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (thisObject->m_navMesh->GetStreamer()) {
+			info.GetIsolate()->ThrowException(Nan::Error("Landmarks need every tile, they can not be built for a streamed mesh"));
 			return;
 		}
-		status = navMesh->init(buffer, bufferSize, DT_TILE_FREE_DATA);
-		if (dtStatusFailed(status)) {
-			dtFree(buffer);
-			dtFreeNavMesh(navMesh);
-			sprintf(charBuffer, "dtNavMesh->init 0x%x", status);
-			isolate->ThrowException(Nan::Error(charBuffer));
+		const int count = info[0]->IsUndefined() ? 8 : Nan::To<int>(info[0]).FromJust();
+		if (count < 1 || count > MAX_LANDMARKS) {
+			Nan::ThrowRangeError("The \"count\" argument must be between 1 and 64");
 			return;
 		}
-		dtFreeNavMesh(thisObject->m_navMesh);
-		thisObject->m_navMesh = navMesh;
-		thisObject->m_navQuery->init(thisObject->m_navMesh, 2048);
-		info.GetReturnValue().Set(Nan::True());
+		const dtQueryFilter *filter = GetQueryFilter(info, 1, &thisObject->m_filter);
+		LandmarkTable *landmarks = new LandmarkTable();
+		landmarks->Build(thisObject->m_navMesh->Get(), thisObject->m_navMesh->GetVersion(), filter, HashQueryFilter(filter), count);
+		thisObject->m_landmarks.reset(landmarks);
+		std::vector<unsigned char> data;
+		landmarks->Save(data);
+		info.GetReturnValue().Set(CopyToTypedArray<v8::Uint8Array>(data.empty() ? NULL : &data[0], data.size()));
+	}
+
+	// loadLandmarks(buffer) uses a table buildLandmarks returned for this
+	// navmesh. Returns the number of landmarks.
+	static NAN_METHOD(LoadLandmarks) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (!info[0]->IsArrayBufferView()) {
+			info.GetIsolate()->ThrowException(Nan::Error("The \"buffer\" argument must be a Buffer or TypedArray"));
+			return;
+		}
+		Nan::TypedArrayContents<unsigned char> contents(info[0]);
+		char charBuffer[1024];
+		LandmarkTable *landmarks = new LandmarkTable();
+		if (!landmarks->Load(thisObject->m_navMesh->Get(), thisObject->m_navMesh->GetVersion(), *contents, contents.length(), charBuffer, sizeof(charBuffer))) {
+			delete landmarks;
+			info.GetIsolate()->ThrowException(Nan::Error(charBuffer));
+			return;
+		}
+		thisObject->m_landmarks.reset(landmarks);
+		info.GetReturnValue().Set(Nan::New(landmarks->GetLandmarkCount()));
+	}
+
+	static NAN_METHOD(ResetStats) {
+		NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+		if (thisObject->m_stats) {
+			thisObject->m_stats->Reset();
+		}
 	}
 
 	static NAN_METHOD(GetAreaCost) {
@@ -262,13 +1794,740 @@ public:
 	}
 
 	static inline Nan::Persistent<v8::Function> & constructor() {
-		static Nan::Persistent<v8::Function> constructor;
+		static thread_local Nan::Persistent<v8::Function> constructor;
+		return constructor;
+	}
+};
+
+class FindStraightPathWorker : public NavQueryWorker {
+private:
+	NavQuery *m_navQuery;
+	SharedNavMesh *m_navMesh;
+	int m_maxNodes;
+	int m_maxPath;
+	dtQueryFilter m_filterCopy;
+	const dtQueryFilter *m_filter;
+	dtPolyRef m_startRef;
+	dtPolyRef m_endRef;
+	float m_startPos[3];
+	float m_endPos[3];
+	dtStatus m_status;
+	QueryContext *m_context;
+	std::shared_ptr<const PortalGraph> m_portalGraph;
+	std::shared_ptr<const LandmarkTable> m_landmarks;
+	int m_straightPathCount;
+public:
+	// A frozen filter is used in place, the caller keeps its object alive.
+	// Any other filter is copied as it is now.
+	FindStraightPathWorker(Nan::Callback *callback, NavQuery *navQuery, const dtQueryFilter *filter, bool shareFilter,
+		dtPolyRef startRef, const float *startPos, dtPolyRef endRef, const float *endPos)
+		: NavQueryWorker(callback), m_navQuery(navQuery), m_navMesh(navQuery->GetSharedNavMesh()), m_maxNodes(navQuery->GetMaxNodes()), m_maxPath(navQuery->GetMaxPath()), m_filterCopy(*filter), m_filter(shareFilter ? filter : &m_filterCopy), m_startRef(startRef), m_endRef(endRef), m_status(0), m_context(NULL), m_portalGraph(navQuery->GetPortalGraph()), m_landmarks(navQuery->GetLandmarks()), m_straightPathCount(0) {
+		dtVcopy(m_startPos, startPos);
+		dtVcopy(m_endPos, endPos);
+		m_navMesh->Ref();
+	}
+
+	void Execute() {
+		m_context = m_navQuery->AcquireWorkerContext(m_navMesh->Get(), m_maxNodes, m_maxPath);
+		if (!m_context) {
+			SetErrorMessage("dtNavMeshQuery->init");
+			return;
+		}
+		const int maxPath = m_context->GetMaxPath();
+		int pathCount = 0;
+		float bmin[3];
+		float bmax[3];
+		PathBounds(m_startPos, m_endPos, bmin, bmax);
+		QueryStatsScope statsScope(m_navQuery->GetStats(), QUERY_STATS_FIND_STRAIGHT_PATH_ASYNC, m_context->navQuery);
+		ResidentScope residentScope(m_navMesh, bmin, bmax, true);
+		m_status = CachedFindPath(m_navQuery->GetPathCache(), m_portalGraph.get(), m_landmarks.get(), m_navQuery->IsBidirectional(), m_navMesh, m_context->navQuery, residentScope, m_startRef, m_endRef, m_startPos, m_endPos, m_filter, &m_context->path[0], &pathCount, maxPath);
+		statsScope.AddStatus(m_status);
+		if (!dtStatusFailed(m_status)) {
+			m_status = m_context->navQuery->findStraightPath(m_startPos, m_endPos, &m_context->path[0], pathCount, &m_context->straightPath[0], &m_context->straightPathFlags[0], &m_context->straightPathRefs[0], &m_straightPathCount, maxPath, 0);
+		}
+	}
+
+	// The context is handed back only after Result() converted its buffers.
+	void WorkComplete() {
+		NavQueryWorker::WorkComplete();
+		if (m_context) {
+			m_navQuery->ReleaseWorkerContext(m_context);
+			m_context = NULL;
+		}
+		m_navMesh->Unref();
+		m_navMesh = NULL;
+	}
+protected:
+	v8::Local<v8::Value> Result() {
+		if (dtStatusFailed(m_status)) {
+			return Nan::New(m_status);
+		}
+		return StraightPathToArray(&m_context->straightPath[0], &m_context->straightPathFlags[0], &m_context->straightPathRefs[0], m_straightPathCount);
+	}
+};
+
+NAN_METHOD(NavQuery::FindStraightPathAsync) {
+	NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+	Nan::Callback *callback = NULL;
+	if (info[info.Length() - 1]->IsFunction()) {
+		callback = new Nan::Callback(info[info.Length() - 1].As<v8::Function>());
+	}
+	if (!info[0]->IsObject() || !info[1]->IsObject()) {
+		info.GetIsolate()->ThrowException(Nan::Error("The \"start\" and \"end\" arguments must be of type object"));
+		delete callback;
+		return;
+	}
+	dtPolyRef startRef = 0;
+	dtPolyRef endRef = 0;
+	float startPos[3];
+	float endPos[3];
+	ReadPosition(info[0], startPos, &startRef);
+	ReadPosition(info[1], endPos, &endRef);
+	const dtQueryFilter *filter = &thisObject->m_filter;
+	bool shareFilter = false;
+	int filterIndex = FindFilterArgument(info, 2);
+	if (filterIndex >= 0) {
+		QueryFilter *queryFilter = Nan::ObjectWrap::Unwrap<QueryFilter>(info[filterIndex].As<v8::Object>());
+		filter = queryFilter->Get();
+		shareFilter = queryFilter->IsFrozen();
+	}
+	FindStraightPathWorker *worker = new FindStraightPathWorker(callback, thisObject, filter, shareFilter, startRef, startPos, endRef, endPos);
+	worker->SaveToPersistent("navQuery", info.Holder());
+	if (shareFilter) {
+		worker->SaveToPersistent("filter", info[filterIndex]);
+	}
+	info.GetReturnValue().Set(worker->Queue());
+}
+
+// A path search spread over several calls with the sliced dtNavMeshQuery API,
+// so a tick loop can bound the iterations spent per frame. The job borrows a
+// query context of its NavQuery until it is finalized, cancelled or collected,
+// and keeps searching the mesh it was created on.
+class PathJob : public Nan::ObjectWrap {
+private:
+	NavQuery *m_navQuery;
+	Nan::Persistent<v8::Object> m_owner;
+	SharedNavMesh *m_navMesh;
+	QueryContext *m_context;
+	dtQueryFilter m_filter;
+	float m_startPos[3];
+	float m_endPos[3];
+	dtStatus m_status;
+
+	PathJob() : m_navQuery(NULL), m_navMesh(NULL), m_context(NULL), m_status(DT_FAILURE) {
+	}
+	~PathJob() {
+		Release();
+	}
+
+	void Release() {
+		if (m_context) {
+			m_navQuery->ReleaseWorkerContext(m_context);
+			m_context = NULL;
+		}
+		if (m_navMesh) {
+			m_navMesh->Unref();
+			m_navMesh = NULL;
+		}
+		m_owner.Reset();
+	}
+public:
+	dtStatus Start(v8::Local<v8::Object> owner, NavQuery *navQuery, const dtQueryFilter &filter, dtPolyRef startRef, const float *startPos, dtPolyRef endRef, const float *endPos) {
+		m_navQuery = navQuery;
+		m_owner.Reset(owner);
+		m_navMesh = navQuery->GetSharedNavMesh();
+		m_navMesh->Ref();
+		m_filter = filter;
+		dtVcopy(m_startPos, startPos);
+		dtVcopy(m_endPos, endPos);
+		m_context = navQuery->AcquireWorkerContext(m_navMesh->Get(), navQuery->GetMaxNodes(), navQuery->GetMaxPath());
+		if (!m_context) {
+			m_status = DT_FAILURE | DT_OUT_OF_MEMORY;
+			Release();
+			return m_status;
+		}
+		float bmin[3];
+		float bmax[3];
+		PathBounds(m_startPos, m_endPos, bmin, bmax);
+		ResidentScope residentScope(m_navMesh, bmin, bmax, true);
+		m_status = m_context->navQuery->initSlicedFindPath(startRef, endRef, m_startPos, m_endPos, &m_filter);
+		return m_status;
+	}
+
+	static NAN_METHOD(New) {
+		if (info.IsConstructCall()) {
+			PathJob *thisObject = new PathJob();
+			thisObject->Wrap(info.This());
+			info.GetReturnValue().Set(info.This());
+		}
+	}
+
+	// step(maxIters) runs at most maxIters search iterations and returns the
+	// status: DT_IN_PROGRESS until the search is done. The iterations used are
+	// stored in job.iterations.
+	static NAN_METHOD(Step) {
+		PathJob* thisObject = Nan::ObjectWrap::Unwrap<PathJob>(info.Holder());
+		int doneIters = 0;
+		if (thisObject->m_context && dtStatusInProgress(thisObject->m_status)) {
+			const int maxIters = dtMax(1, Nan::To<int>(info[0]).FromMaybe(1));
+			float bmin[3];
+			float bmax[3];
+			PathBounds(thisObject->m_startPos, thisObject->m_endPos, bmin, bmax);
+			ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, true);
+			thisObject->m_status = thisObject->m_context->navQuery->updateSlicedFindPath(maxIters, &doneIters);
+		}
+		Nan::Set(info.This(), Nan::New("iterations").ToLocalChecked(), Nan::New(doneIters));
+		info.GetReturnValue().Set(Nan::New(thisObject->m_status));
+	}
+
+	// finalize([points, refs, flags]) returns the straight path like
+	// findStraightPath. A search still in progress returns the best partial
+	// path found so far. The job is finished afterwards.
+	static NAN_METHOD(Finalize) {
+		PathJob* thisObject = Nan::ObjectWrap::Unwrap<PathJob>(info.Holder());
+		QueryContext *context = thisObject->m_context;
+		if (!context || dtStatusFailed(thisObject->m_status)) {
+			info.GetReturnValue().Set(Nan::New(thisObject->m_status));
+			thisObject->Release();
+			return;
+		}
+		ResidentScope residentScope(thisObject->m_navMesh, NULL, NULL, false);
+		int pathCount = 0;
+		dtStatus status = context->navQuery->finalizeSlicedFindPath(&context->path[0], &pathCount, context->GetMaxPath());
+		if (dtStatusFailed(status)) {
+			info.GetReturnValue().Set(Nan::New(status));
+		} else {
+			SetStraightPathResult(info, 0, *context, thisObject->m_startPos, thisObject->m_endPos, &context->path[0], pathCount);
+		}
+		thisObject->m_status = DT_FAILURE;
+		thisObject->Release();
+	}
+
+	// cancel() gives the query context back without building a path.
+	static NAN_METHOD(Cancel) {
+		PathJob* thisObject = Nan::ObjectWrap::Unwrap<PathJob>(info.Holder());
+		thisObject->m_status = DT_FAILURE;
+		thisObject->Release();
+	}
+
+	static inline Nan::Persistent<v8::Function> & constructor() {
+		static thread_local Nan::Persistent<v8::Function> constructor;
+		return constructor;
+	}
+};
+
+// createPathJob(start, end[, filter]) starts a sliced search between two
+// {x,y,z,ref} positions. Advance it with job.step(maxIters).
+NAN_METHOD(NavQuery::CreatePathJob) {
+	NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+	if (!info[0]->IsObject() || !info[1]->IsObject()) {
+		info.GetIsolate()->ThrowException(Nan::Error("The \"start\" and \"end\" arguments must be of type object"));
+		return;
+	}
+	dtPolyRef startRef = 0;
+	dtPolyRef endRef = 0;
+	float startPos[3];
+	float endPos[3];
+	ReadPosition(info[0], startPos, &startRef);
+	ReadPosition(info[1], endPos, &endRef);
+	v8::Local<v8::Object> job = Nan::NewInstance(Nan::New(PathJob::constructor())).ToLocalChecked();
+	dtStatus status = Nan::ObjectWrap::Unwrap<PathJob>(job)->Start(info.Holder(), thisObject, *GetQueryFilter(info, 2, &thisObject->m_filter), startRef, startPos, endRef, endPos);
+	Nan::Set(job, Nan::New("status").ToLocalChecked(), Nan::New(status));
+	info.GetReturnValue().Set(job);
+}
+
+static const int DEFAULT_QUEUE_AGING = 8;
+// Iterations run between clock reads when update has a time budget.
+static const int QUEUE_TIME_SLICE = 32;
+
+// A path request queue in the spirit of dtPathQueue, without its fixed
+// MAX_QUEUE: any number of requests wait in a heap ordered by priority, then
+// arrival. A waiting request gains one priority level every `aging` update
+// calls, so a steady stream of urgent requests cannot starve the rest.
+// Requests sharing a dedupe key collapse into one, keeping the newest end
+// points. One sliced search runs at a time and resumes across updates.
+class PathQueue : public Nan::ObjectWrap {
+private:
+	enum RequestState {
+		REQUEST_QUEUED,
+		REQUEST_RUNNING,
+		REQUEST_DONE,
+	};
+
+	struct PathRequest {
+		unsigned int handle;
+		RequestState state;
+		int priority;
+		unsigned int generation;
+		unsigned long long enqueueTick;
+		std::string key;
+		dtPolyRef startRef;
+		dtPolyRef endRef;
+		float startPos[3];
+		float endPos[3];
+		dtQueryFilter filter;
+		dtStatus status;
+		std::vector<dtPolyRef> path;
+		// The mesh generation the path was found on.
+		unsigned int meshGeneration;
+	};
+
+	// Heap entries go stale when their request is re-prioritised, restarted
+	// or removed; generation tells them apart.
+	struct HeapEntry {
+		double order;
+		unsigned long long sequence;
+		unsigned int handle;
+		unsigned int generation;
+
+		bool operator<(const HeapEntry &other) const {
+			if (order != other.order) return order < other.order;
+			return sequence > other.sequence;
+		}
+	};
+
+	NavQuery *m_navQuery;
+	Nan::Persistent<v8::Object> m_owner;
+	SharedNavMesh *m_navMesh;
+	// Counts the meshes followed, refs of completed paths are only valid on
+	// the one they were found on.
+	unsigned int m_meshGeneration;
+	QueryContext *m_context;
+	int m_aging;
+	unsigned int m_nextHandle;
+	unsigned long long m_sequence;
+	unsigned long long m_tick;
+	std::map<unsigned int, PathRequest*> m_requests;
+	std::map<std::string, unsigned int> m_keys;
+	std::vector<HeapEntry> m_heap;
+	PathRequest *m_running;
+
+	PathQueue() : m_navQuery(NULL), m_navMesh(NULL), m_meshGeneration(0), m_context(NULL), m_aging(DEFAULT_QUEUE_AGING), m_nextHandle(1), m_sequence(0), m_tick(0), m_running(NULL) {
+	}
+	~PathQueue() {
+		for (std::map<unsigned int, PathRequest*>::iterator it = m_requests.begin(); it != m_requests.end(); ++it) {
+			delete it->second;
+		}
+		m_requests.clear();
+		if (m_context) {
+			m_navQuery->ReleaseWorkerContext(m_context);
+			m_context = NULL;
+		}
+		if (m_navMesh) {
+			m_navMesh->Unref();
+			m_navMesh = NULL;
+		}
+		m_owner.Reset();
+	}
+
+	void Push(PathRequest *request) {
+		HeapEntry entry;
+		entry.order = request->priority;
+		if (m_aging > 0) {
+			// priority + (tick - enqueueTick) / aging, minus the part that grows
+			// alike for every request.
+			entry.order -= (double)request->enqueueTick / m_aging;
+		}
+		entry.sequence = m_sequence++;
+		entry.handle = request->handle;
+		entry.generation = ++request->generation;
+		request->state = REQUEST_QUEUED;
+		m_heap.push_back(entry);
+		std::push_heap(m_heap.begin(), m_heap.end());
+	}
+
+	PathRequest *Pop() {
+		while (!m_heap.empty()) {
+			std::pop_heap(m_heap.begin(), m_heap.end());
+			HeapEntry entry = m_heap.back();
+			m_heap.pop_back();
+			std::map<unsigned int, PathRequest*>::iterator it = m_requests.find(entry.handle);
+			if (it != m_requests.end() && it->second->state == REQUEST_QUEUED && it->second->generation == entry.generation) {
+				return it->second;
+			}
+		}
+		return NULL;
+	}
+
+	void Remove(PathRequest *request) {
+		if (m_running == request) {
+			m_running = NULL;
+		}
+		if (!request->key.empty()) {
+			std::map<std::string, unsigned int>::iterator it = m_keys.find(request->key);
+			if (it != m_keys.end() && it->second == request->handle) {
+				m_keys.erase(it);
+			}
+		}
+		m_requests.erase(request->handle);
+		delete request;
+	}
+
+	PathRequest *Find(v8::Local<v8::Value> value) {
+		std::map<unsigned int, PathRequest*>::iterator it = m_requests.find(Nan::To<uint32_t>(value).FromMaybe(0));
+		return it != m_requests.end() ? it->second : NULL;
+	}
+
+	// Follows the NavQuery to the mesh it currently uses. Searches in flight
+	// are restarted, their refs are checked again when they run.
+	bool SyncNavMesh() {
+		SharedNavMesh *navMesh = m_navQuery->GetSharedNavMesh();
+		if (navMesh == m_navMesh && m_context) {
+			return true;
+		}
+		navMesh->Ref();
+		if (m_navMesh) {
+			m_navMesh->Unref();
+		}
+		m_navMesh = navMesh;
+		m_meshGeneration++;
+		if (m_context) {
+			m_navQuery->ReleaseWorkerContext(m_context);
+		}
+		m_context = m_navQuery->AcquireWorkerContext(m_navMesh->Get(), m_navQuery->GetMaxNodes(), m_navQuery->GetMaxPath());
+		if (m_running) {
+			Push(m_running);
+			m_running = NULL;
+		}
+		return m_context != NULL;
+	}
+
+	void Complete(PathRequest *request, dtStatus status, std::vector<unsigned int> &completed) {
+		request->state = REQUEST_DONE;
+		request->status = status;
+		request->meshGeneration = m_meshGeneration;
+		if (m_running == request) {
+			m_running = NULL;
+		}
+		completed.push_back(request->handle);
+	}
+public:
+	void Start(v8::Local<v8::Object> owner, NavQuery *navQuery, int aging) {
+		m_navQuery = navQuery;
+		m_owner.Reset(owner);
+		m_aging = aging;
+	}
+
+	static NAN_METHOD(New) {
+		if (info.IsConstructCall()) {
+			PathQueue *thisObject = new PathQueue();
+			thisObject->Wrap(info.This());
+			info.GetReturnValue().Set(info.This());
+		}
+	}
+
+	// request(start, end[, priority[, key]][, filter]) queues a search between
+	// two {x,y,z,ref} positions with a copy of the filter, by default the one
+	// of the NavQuery, and returns its handle. A pending request with the same key is updated in
+	// place instead, keeping its handle and its place in the queue.
+	static NAN_METHOD(Request) {
+		PathQueue* thisObject = Nan::ObjectWrap::Unwrap<PathQueue>(info.Holder());
+		if (!info[0]->IsObject() || !info[1]->IsObject()) {
+			info.GetIsolate()->ThrowException(Nan::Error("The \"start\" and \"end\" arguments must be of type object"));
+			return;
+		}
+		const int priority = info[2]->IsNumber() ? Nan::To<int>(info[2]).FromJust() : 0;
+		std::string key;
+		if (info[3]->IsString() || info[3]->IsNumber()) {
+			key = *Nan::Utf8String(info[3]);
+		}
+		PathRequest *request = NULL;
+		if (!key.empty()) {
+			std::map<std::string, unsigned int>::iterator it = thisObject->m_keys.find(key);
+			if (it != thisObject->m_keys.end() && thisObject->m_requests[it->second]->state != REQUEST_DONE) {
+				request = thisObject->m_requests[it->second];
+			}
+		}
+		if (!request) {
+			request = new PathRequest();
+			request->handle = thisObject->m_nextHandle++;
+			if (thisObject->m_nextHandle == 0) thisObject->m_nextHandle++;
+			request->priority = priority;
+			request->generation = 0;
+			request->enqueueTick = thisObject->m_tick;
+			request->key = key;
+			thisObject->m_requests[request->handle] = request;
+			if (!key.empty()) {
+				thisObject->m_keys[key] = request->handle;
+			}
+		} else {
+			request->priority = dtMax(request->priority, priority);
+			if (thisObject->m_running == request) {
+				thisObject->m_running = NULL;
+			}
+		}
+		ReadPosition(info[0], request->startPos, &request->startRef);
+		ReadPosition(info[1], request->endPos, &request->endRef);
+		request->filter = *GetQueryFilter(info, 2, &thisObject->m_navQuery->GetFilter());
+		request->status = DT_IN_PROGRESS;
+		thisObject->Push(request);
+		info.GetReturnValue().Set(Nan::New(request->handle));
+	}
+
+	// update(maxIters[, maxMicros]) advances the queue by at most maxIters
+	// search iterations and, when given, about maxMicros microseconds. Returns
+	// a Uint32Array with the handles completed during this call.
+	static NAN_METHOD(Update) {
+		PathQueue* thisObject = Nan::ObjectWrap::Unwrap<PathQueue>(info.Holder());
+		int iterations = dtMax(1, Nan::To<int>(info[0]).FromMaybe(1));
+		const double maxMicros = info[1]->IsNumber() ? Nan::To<double>(info[1]).FromJust() : 0;
+		const uint64_t deadline = uv_hrtime() + (uint64_t)(maxMicros * 1000);
+		std::vector<unsigned int> completed;
+		thisObject->m_tick++;
+		if (!thisObject->SyncNavMesh()) {
+			info.GetIsolate()->ThrowException(Nan::Error("dtNavMeshQuery->init"));
+			return;
+		}
+		dtNavMeshQuery *navQuery = thisObject->m_context->navQuery;
+		while (iterations > 0) {
+			PathRequest *request = thisObject->m_running;
+			if (!request) {
+				request = thisObject->Pop();
+				if (!request) {
+					break;
+				}
+				request->state = REQUEST_RUNNING;
+				thisObject->m_running = request;
+				float bmin[3];
+				float bmax[3];
+				PathBounds(request->startPos, request->endPos, bmin, bmax);
+				ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, true);
+				dtStatus status = navQuery->initSlicedFindPath(request->startRef, request->endRef, request->startPos, request->endPos, &request->filter);
+				if (dtStatusFailed(status)) {
+					thisObject->Complete(request, status, completed);
+					continue;
+				}
+			}
+			float bmin[3];
+			float bmax[3];
+			PathBounds(request->startPos, request->endPos, bmin, bmax);
+			ResidentScope residentScope(thisObject->m_navMesh, bmin, bmax, true);
+			int doneIters = 0;
+			dtStatus status = navQuery->updateSlicedFindPath(maxMicros > 0 ? dtMin(iterations, QUEUE_TIME_SLICE) : iterations, &doneIters);
+			iterations -= dtMax(1, doneIters);
+			if (dtStatusSucceed(status)) {
+				int pathCount = 0;
+				request->path.resize(thisObject->m_context->GetMaxPath());
+				status = navQuery->finalizeSlicedFindPath(&request->path[0], &pathCount, (int)request->path.size());
+				request->path.resize(dtStatusFailed(status) ? 0 : pathCount);
+			}
+			if (!dtStatusInProgress(status)) {
+				thisObject->Complete(request, status, completed);
+			}
+			if (maxMicros > 0 && uv_hrtime() >= deadline) {
+				break;
+			}
+		}
+		info.GetReturnValue().Set(CopyToTypedArray<v8::Uint32Array>(completed.empty() ? NULL : &completed[0], completed.size()));
+	}
+
+	// getStatus(handle) is DT_IN_PROGRESS while the request waits or runs,
+	// the search status once it completed and DT_FAILURE for unknown handles.
+	static NAN_METHOD(GetStatus) {
+		PathQueue* thisObject = Nan::ObjectWrap::Unwrap<PathQueue>(info.Holder());
+		PathRequest *request = thisObject->Find(info[0]);
+		info.GetReturnValue().Set(Nan::New(request ? request->status : DT_FAILURE));
+	}
+
+	// getResult(handle[, points, refs, flags]) returns the straight path of a
+	// completed request like findStraightPath and forgets the request. A path
+	// found before the NavQuery switched meshes gives DT_FAILURE.
+	static NAN_METHOD(GetResult) {
+		PathQueue* thisObject = Nan::ObjectWrap::Unwrap<PathQueue>(info.Holder());
+		PathRequest *request = thisObject->Find(info[0]);
+		if (!request || request->state != REQUEST_DONE) {
+			info.GetReturnValue().Set(Nan::New(request ? DT_IN_PROGRESS : DT_FAILURE));
+			return;
+		}
+		if (dtStatusFailed(request->status)) {
+			info.GetReturnValue().Set(Nan::New(request->status));
+		} else if (!thisObject->SyncNavMesh()) {
+			info.GetReturnValue().Set(Nan::New(DT_FAILURE | DT_OUT_OF_MEMORY));
+		} else if (request->meshGeneration != thisObject->m_meshGeneration) {
+			info.GetReturnValue().Set(Nan::New(DT_FAILURE));
+		} else {
+			ResidentScope residentScope(thisObject->m_navMesh, NULL, NULL, false);
+			SetStraightPathResult(info, 1, *thisObject->m_context, request->startPos, request->endPos, request->path.empty() ? NULL : &request->path[0], (int)request->path.size());
+		}
+		thisObject->Remove(request);
+	}
+
+	// cancel(handle) drops a request in any state.
+	static NAN_METHOD(Cancel) {
+		PathQueue* thisObject = Nan::ObjectWrap::Unwrap<PathQueue>(info.Holder());
+		PathRequest *request = thisObject->Find(info[0]);
+		if (request) {
+			thisObject->Remove(request);
+		}
+		info.GetReturnValue().Set(Nan::New(request != NULL));
+	}
+
+	// size() is the number of requests not yet collected.
+	static NAN_METHOD(Size) {
+		PathQueue* thisObject = Nan::ObjectWrap::Unwrap<PathQueue>(info.Holder());
+		info.GetReturnValue().Set(Nan::New((unsigned int)thisObject->m_requests.size()));
+	}
+
+	static inline Nan::Persistent<v8::Function> & constructor() {
+		static thread_local Nan::Persistent<v8::Function> constructor;
 		return constructor;
 	}
 };
 
+// createPathQueue([{ aging }]) creates a queue that searches the mesh of this
+// NavQuery. aging is the number of update calls after which a waiting request
+// gains a priority level, 0 disables aging.
+NAN_METHOD(NavQuery::CreatePathQueue) {
+	NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+	int aging = DEFAULT_QUEUE_AGING;
+	if (info[0]->IsObject()) {
+		v8::Local<v8::Value> agingValue = Nan::Get(info[0].As<v8::Object>(), Nan::New("aging").ToLocalChecked()).ToLocalChecked();
+		if (!agingValue->IsUndefined()) {
+			aging = Nan::To<int>(agingValue).FromJust();
+			if (aging < 0) {
+				Nan::ThrowRangeError("The \"aging\" option must be a non-negative integer");
+				return;
+			}
+		}
+	}
+	v8::Local<v8::Object> queue = Nan::NewInstance(Nan::New(PathQueue::constructor())).ToLocalChecked();
+	Nan::ObjectWrap::Unwrap<PathQueue>(queue)->Start(info.Holder(), thisObject, aging);
+	info.GetReturnValue().Set(queue);
+}
+
+// Reads and builds a navmesh on the threadpool, then swaps it into the
+// NavMesh or NavQuery on the JS thread.
+class LoadWorker : public NavQueryWorker {
+private:
+	NavMesh *m_navMesh;
+	NavQuery *m_navQuery;
+	std::string m_path;
+	LoadOptions m_loadOptions;
+	int m_maxNodes;
+	int m_maxPath;
+	SharedNavMesh *m_result;
+public:
+	LoadWorker(Nan::Callback *callback, NavMesh *navMesh, NavQuery *navQuery, const char *path, const LoadOptions &loadOptions, int maxNodes, int maxPath)
+		: NavQueryWorker(callback), m_navMesh(navMesh), m_navQuery(navQuery), m_path(path), m_loadOptions(loadOptions), m_maxNodes(maxNodes), m_maxPath(maxPath), m_result(NULL) {
+	}
+	~LoadWorker() {
+		if (m_result) {
+			m_result->Unref();
+		}
+	}
+
+	void Execute() {
+		char charBuffer[1024];
+		m_result = LoadNavMesh(m_path.c_str(), m_loadOptions, charBuffer, sizeof(charBuffer));
+		if (!m_result) {
+			SetErrorMessage(charBuffer);
+		}
+	}
+protected:
+	v8::Local<v8::Value> Result() {
+		if (m_navMesh) {
+			m_navMesh->SetSharedNavMesh(m_result);
+		} else {
+			m_navQuery->SetNavMesh(m_result, m_maxNodes, m_maxPath);
+		}
+		m_result = NULL;
+		Nan::Set(GetFromPersistent("target").As<v8::Object>(), Nan::New("filename").ToLocalChecked(), Nan::New(m_path).ToLocalChecked());
+		return Nan::True();
+	}
+};
+
+// loadAsync(path[, options][, callback]) loads without blocking the event
+// loop. Queries keep using the current mesh until the new one is swapped in.
+NAN_METHOD(NavMesh::LoadAsync) {
+	NavMesh* thisObject = Nan::ObjectWrap::Unwrap<NavMesh>(info.Holder());
+	if (info[0]->IsString() == false) {
+		info.GetIsolate()->ThrowException(Nan::Error("The \"path\" argument must be of type string"));
+		return;
+	}
+	LoadOptions loadOptions;
+	if (!ReadLoadOptions(info[1], &loadOptions)) {
+		return;
+	}
+	Nan::Callback *callback = NULL;
+	if (info[info.Length() - 1]->IsFunction()) {
+		callback = new Nan::Callback(info[info.Length() - 1].As<v8::Function>());
+	}
+	Nan::Utf8String path(info[0]);
+	LoadWorker *worker = new LoadWorker(callback, thisObject, NULL, *path, loadOptions, 0, 0);
+	worker->SaveToPersistent("target", info.Holder());
+	info.GetReturnValue().Set(worker->Queue());
+}
+
+NAN_METHOD(NavQuery::LoadAsync) {
+	NavQuery* thisObject = Nan::ObjectWrap::Unwrap<NavQuery>(info.Holder());
+	if (info[0]->IsString() == false) {
+		info.GetIsolate()->ThrowException(Nan::Error("The \"path\" argument must be of type string"));
+		return;
+	}
+	int maxNodes = thisObject->m_maxNodes;
+	int maxPath = thisObject->m_maxPath;
+	LoadOptions loadOptions;
+	if (!ReadQueryOptions(info[1], &maxNodes, &maxPath) || !ReadLoadOptions(info[1], &loadOptions)) {
+		return;
+	}
+	Nan::Callback *callback = NULL;
+	if (info[info.Length() - 1]->IsFunction()) {
+		callback = new Nan::Callback(info[info.Length() - 1].As<v8::Function>());
+	}
+	Nan::Utf8String path(info[0]);
+	LoadWorker *worker = new LoadWorker(callback, NULL, thisObject, *path, loadOptions, maxNodes, maxPath);
+	worker->SaveToPersistent("target", info.Holder());
+	info.GetReturnValue().Set(worker->Queue());
+}
+
+// convertNavMesh(input, output[, { compress }]) rewrites any loadable navmesh
+// file as an indexed tile set. compress is false, true (fastlz level 2) or 1/2.
+static NAN_METHOD(ConvertNavMesh) {
+	Isolate *isolate = info.GetIsolate();
+	if (info[0]->IsString() == false || info[1]->IsString() == false) {
+		isolate->ThrowException(Nan::Error("The \"input\" and \"output\" arguments must be of type string"));
+		return;
+	}
+	int compressionLevel = 0;
+	if (info[2]->IsObject()) {
+		v8::Local<v8::Value> compress = Nan::Get(info[2].As<v8::Object>(), Nan::New("compress").ToLocalChecked()).ToLocalChecked();
+		if (compress->IsNumber()) {
+			compressionLevel = dtClamp(Nan::To<int>(compress).FromJust(), 0, 2);
+		} else if (Nan::To<bool>(compress).FromJust()) {
+			compressionLevel = 2;
+		}
+	}
+	char charBuffer[1024];
+	Nan::Utf8String input(info[0]);
+	Nan::Utf8String output(info[1]);
+	SharedNavMesh *navMesh = LoadNavMeshFile(*input, charBuffer, sizeof(charBuffer));
+	if (!navMesh) {
+		isolate->ThrowException(Nan::Error(charBuffer));
+		return;
+	}
+	bool saved = SaveTileSet(navMesh->Get(), *output, compressionLevel, charBuffer, sizeof(charBuffer));
+	navMesh->Unref();
+	if (!saved) {
+		isolate->ThrowException(Nan::Error(charBuffer));
+		return;
+	}
+	info.GetReturnValue().Set(Nan::True());
+}
+
+// Drops the persistent handles of an isolate before a worker thread that
+// loaded the addon tears it down.
+static void ResetPersistents(void * /*data*/) {
+	PropertyKeys::get().Reset();
+	NavMesh::functionTemplate().Reset();
+	QueryFilter::functionTemplate().Reset();
+	PathJob::constructor().Reset();
+	PathQueue::constructor().Reset();
+	NavQuery::constructor().Reset();
+}
+
 static NAN_MODULE_INIT(Init) {
-	srand(time(0));
+	PropertyKeys::get().Init();
+	node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), ResetPersistents, NULL);
 
 	v8::Local<v8::Object> constants = Nan::New<v8::Object>();
 	Nan::Set(constants, Nan::New("SAMPLE_POLYAREA_GROUND").ToLocalChecked(), Nan::New(SAMPLE_POLYAREA_GROUND));
@@ -283,16 +2542,99 @@ static NAN_MODULE_INIT(Init) {
 	Nan::Set(constants, Nan::New("SAMPLE_POLYFLAGS_JUMP").ToLocalChecked(), Nan::New(SAMPLE_POLYFLAGS_JUMP));
 	Nan::Set(constants, Nan::New("SAMPLE_POLYFLAGS_DISABLED").ToLocalChecked(), Nan::New(SAMPLE_POLYFLAGS_DISABLED));
 	Nan::Set(constants, Nan::New("SAMPLE_POLYFLAGS_ALL").ToLocalChecked(), Nan::New(SAMPLE_POLYFLAGS_ALL));
+	Nan::Set(constants, Nan::New("DT_FAILURE").ToLocalChecked(), Nan::New(DT_FAILURE));
+	Nan::Set(constants, Nan::New("DT_SUCCESS").ToLocalChecked(), Nan::New(DT_SUCCESS));
+	Nan::Set(constants, Nan::New("DT_IN_PROGRESS").ToLocalChecked(), Nan::New(DT_IN_PROGRESS));
+	Nan::Set(constants, Nan::New("DT_BUFFER_TOO_SMALL").ToLocalChecked(), Nan::New(DT_BUFFER_TOO_SMALL));
+	Nan::Set(constants, Nan::New("DT_OUT_OF_NODES").ToLocalChecked(), Nan::New(DT_OUT_OF_NODES));
+	Nan::Set(constants, Nan::New("DT_PARTIAL_RESULT").ToLocalChecked(), Nan::New(DT_PARTIAL_RESULT));
+	Nan::Set(constants, Nan::New("DT_STRAIGHTPATH_START").ToLocalChecked(), Nan::New(DT_STRAIGHTPATH_START));
+	Nan::Set(constants, Nan::New("DT_STRAIGHTPATH_END").ToLocalChecked(), Nan::New(DT_STRAIGHTPATH_END));
+	Nan::Set(constants, Nan::New("DT_STRAIGHTPATH_OFFMESH_CONNECTION").ToLocalChecked(), Nan::New(DT_STRAIGHTPATH_OFFMESH_CONNECTION));
+	Nan::Set(constants, Nan::New("DT_RAYCAST_USE_COSTS").ToLocalChecked(), Nan::New(DT_RAYCAST_USE_COSTS));
 	Nan::Set(target, Nan::New("constants").ToLocalChecked(), constants);
 
+	Nan::SetMethod(target, "convertNavMesh", ConvertNavMesh);
+
+	v8::Local<v8::FunctionTemplate> navMesh = Nan::New<v8::FunctionTemplate>(NavMesh::New);
+	navMesh->SetClassName(Nan::New("NavMesh").ToLocalChecked());
+	navMesh->InstanceTemplate()->SetInternalFieldCount(1);
+	Nan::SetPrototypeMethod(navMesh, "load", NavMesh::Load);
+	Nan::SetPrototypeMethod(navMesh, "loadAsync", NavMesh::LoadAsync);
+	Nan::SetPrototypeMethod(navMesh, "loadFromBuffer", NavMesh::LoadFromBuffer);
+	Nan::SetPrototypeMethod(navMesh, "getTileStats", NavMesh::GetTileStats);
+	Nan::SetPrototypeMethod(navMesh, "share", NavMesh::Share);
+	Nan::SetPrototypeMethod(navMesh, "attach", NavMesh::Attach);
+	NavMesh::functionTemplate().Reset(navMesh);
+	Nan::Set(target, Nan::New("NavMesh").ToLocalChecked(), Nan::GetFunction(navMesh).ToLocalChecked());
+
+	v8::Local<v8::FunctionTemplate> queryFilter = Nan::New<v8::FunctionTemplate>(QueryFilter::New);
+	queryFilter->SetClassName(Nan::New("QueryFilter").ToLocalChecked());
+	queryFilter->InstanceTemplate()->SetInternalFieldCount(1);
+	Nan::SetPrototypeMethod(queryFilter, "getAreaCost", QueryFilter::GetAreaCost);
+	Nan::SetPrototypeMethod(queryFilter, "setAreaCost", QueryFilter::SetAreaCost);
+	Nan::SetPrototypeMethod(queryFilter, "getIncludeFlags", QueryFilter::GetIncludeFlags);
+	Nan::SetPrototypeMethod(queryFilter, "setIncludeFlags", QueryFilter::SetIncludeFlags);
+	Nan::SetPrototypeMethod(queryFilter, "getExcludeFlags", QueryFilter::GetExcludeFlags);
+	Nan::SetPrototypeMethod(queryFilter, "setExcludeFlags", QueryFilter::SetExcludeFlags);
+	Nan::SetPrototypeMethod(queryFilter, "freeze", QueryFilter::Freeze);
+	Nan::SetPrototypeMethod(queryFilter, "isFrozen", QueryFilter::IsFrozen);
+	QueryFilter::functionTemplate().Reset(queryFilter);
+	Nan::Set(target, Nan::New("QueryFilter").ToLocalChecked(), Nan::GetFunction(queryFilter).ToLocalChecked());
+
+	v8::Local<v8::FunctionTemplate> pathJob = Nan::New<v8::FunctionTemplate>(PathJob::New);
+	pathJob->SetClassName(Nan::New("PathJob").ToLocalChecked());
+	pathJob->InstanceTemplate()->SetInternalFieldCount(1);
+	Nan::SetPrototypeMethod(pathJob, "step", PathJob::Step);
+	Nan::SetPrototypeMethod(pathJob, "finalize", PathJob::Finalize);
+	Nan::SetPrototypeMethod(pathJob, "cancel", PathJob::Cancel);
+	PathJob::constructor().Reset(Nan::GetFunction(pathJob).ToLocalChecked());
+
+	v8::Local<v8::FunctionTemplate> pathQueue = Nan::New<v8::FunctionTemplate>(PathQueue::New);
+	pathQueue->SetClassName(Nan::New("PathQueue").ToLocalChecked());
+	pathQueue->InstanceTemplate()->SetInternalFieldCount(1);
+	Nan::SetPrototypeMethod(pathQueue, "request", PathQueue::Request);
+	Nan::SetPrototypeMethod(pathQueue, "update", PathQueue::Update);
+	Nan::SetPrototypeMethod(pathQueue, "getStatus", PathQueue::GetStatus);
+	Nan::SetPrototypeMethod(pathQueue, "getResult", PathQueue::GetResult);
+	Nan::SetPrototypeMethod(pathQueue, "cancel", PathQueue::Cancel);
+	Nan::SetPrototypeMethod(pathQueue, "size", PathQueue::Size);
+	PathQueue::constructor().Reset(Nan::GetFunction(pathQueue).ToLocalChecked());
+
 	v8::Local<v8::FunctionTemplate> navQuery = Nan::New<v8::FunctionTemplate>(NavQuery::New);
 	navQuery->SetClassName(Nan::New("NavQuery").ToLocalChecked());
 	navQuery->InstanceTemplate()->SetInternalFieldCount(1);
 	Nan::SetPrototypeMethod(navQuery, "load", NavQuery::Load);
+	Nan::SetPrototypeMethod(navQuery, "loadAsync", NavQuery::LoadAsync);
+	Nan::SetPrototypeMethod(navQuery, "loadFromBuffer", NavQuery::LoadFromBuffer);
 	Nan::SetPrototypeMethod(navQuery, "clear", NavQuery::Clear);
+	Nan::SetPrototypeMethod(navQuery, "attach", NavQuery::Attach);
+	Nan::SetPrototypeMethod(navQuery, "share", NavQuery::Share);
 	Nan::SetPrototypeMethod(navQuery, "findNearestPoly", NavQuery::FindNearestPoly);
+	Nan::SetPrototypeMethod(navQuery, "findNearestPolyBatch", NavQuery::FindNearestPolyBatch);
 	Nan::SetPrototypeMethod(navQuery, "findRandomPoint", NavQuery::FindRandomPoint);
+	Nan::SetPrototypeMethod(navQuery, "findRandomPoints", NavQuery::FindRandomPoints);
+	Nan::SetPrototypeMethod(navQuery, "seed", NavQuery::Seed);
+	Nan::SetPrototypeMethod(navQuery, "findRandomPointAroundCircle", NavQuery::FindRandomPointAroundCircle);
+	Nan::SetPrototypeMethod(navQuery, "findPolysAroundCircle", NavQuery::FindPolysAroundCircle);
+	Nan::SetPrototypeMethod(navQuery, "findLocalNeighbourhood", NavQuery::FindLocalNeighbourhood);
 	Nan::SetPrototypeMethod(navQuery, "findStraightPath", NavQuery::FindStraightPath);
+	Nan::SetPrototypeMethod(navQuery, "findStraightPathAsync", NavQuery::FindStraightPathAsync);
+	Nan::SetPrototypeMethod(navQuery, "findStraightPathBatch", NavQuery::FindStraightPathBatch);
+	Nan::SetPrototypeMethod(navQuery, "createPathJob", NavQuery::CreatePathJob);
+	Nan::SetPrototypeMethod(navQuery, "createPathQueue", NavQuery::CreatePathQueue);
+	Nan::SetPrototypeMethod(navQuery, "raycast", NavQuery::Raycast);
+	Nan::SetPrototypeMethod(navQuery, "moveAlongSurface", NavQuery::MoveAlongSurface);
+	Nan::SetPrototypeMethod(navQuery, "findDistanceToWall", NavQuery::FindDistanceToWall);
+	Nan::SetPrototypeMethod(navQuery, "getTileStats", NavQuery::GetTileStats);
+	Nan::SetPrototypeMethod(navQuery, "setPolyFlags", NavQuery::SetPolyFlags);
+	Nan::SetPrototypeMethod(navQuery, "getPolyFlags", NavQuery::GetPolyFlags);
+	Nan::SetPrototypeMethod(navQuery, "getPathCacheStats", NavQuery::GetPathCacheStats);
+	Nan::SetPrototypeMethod(navQuery, "getStats", NavQuery::GetStats);
+	Nan::SetPrototypeMethod(navQuery, "buildPortalGraph", NavQuery::BuildPortalGraph);
+	Nan::SetPrototypeMethod(navQuery, "buildLandmarks", NavQuery::BuildLandmarks);
+	Nan::SetPrototypeMethod(navQuery, "loadLandmarks", NavQuery::LoadLandmarks);
+	Nan::SetPrototypeMethod(navQuery, "resetStats", NavQuery::ResetStats);
 	Nan::SetPrototypeMethod(navQuery, "getAreaCost", NavQuery::GetAreaCost);
 	Nan::SetPrototypeMethod(navQuery, "setAreaCost", NavQuery::SetAreaCost);
 	Nan::SetPrototypeMethod(navQuery, "getIncludeFlags", NavQuery::GetIncludeFlags);
@@ -303,4 +2645,4 @@ static NAN_MODULE_INIT(Init) {
 	Nan::Set(target, Nan::New("NavQuery").ToLocalChecked(), Nan::GetFunction(navQuery).ToLocalChecked());
 }
 
-NODE_MODULE(NODE_GYP_MODULE_NAME, Init)
+NAN_MODULE_WORKER_ENABLED(NODE_GYP_MODULE_NAME, Init)
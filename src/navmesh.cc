@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Sample.h"
+#include "DetourAlloc.h"
+#include "navmesh.h"
+#include "tileset.h"
+
+// Tile set layout written by Sample::saveAll in RecastDemo/Source/Sample.cpp.
+static const int NAVMESHSET_MAGIC = 'M'<<24 | 'S'<<16 | 'E'<<8 | 'T'; //'MSET';
+static const int NAVMESHSET_VERSION = 1;
+
+struct NavMeshSetHeader {
+	int magic;
+	int version;
+	int numTiles;
+	dtNavMeshParams params;
+};
+
+struct NavMeshTileHeader {
+	dtTileRef tileRef;
+	int dataSize;
+};
+
+SharedNavMesh::SharedNavMesh(dtNavMesh *navMesh, void (*release)(void *releaseData), void *releaseData)
+	: m_navMesh(navMesh), m_release(release), m_releaseData(releaseData), m_streamer(NULL), m_refs(1), m_version(0) {
+}
+
+SharedNavMesh::SharedNavMesh(dtNavMesh *navMesh, TileStreamer *streamer)
+	: m_navMesh(navMesh), m_release(NULL), m_releaseData(NULL), m_streamer(streamer), m_refs(1), m_version(0) {
+}
+
+SharedNavMesh::~SharedNavMesh() {
+	dtFreeNavMesh(m_navMesh);
+	m_navMesh = NULL;
+	if (m_release) {
+		m_release(m_releaseData);
+	}
+	delete m_streamer;
+	m_streamer = NULL;
+}
+
+void SharedNavMesh::Ref() {
+	m_refs.fetch_add(1);
+}
+
+void SharedNavMesh::Unref() {
+	if (m_refs.fetch_sub(1) == 1) {
+		delete this;
+	}
+}
+
+dtNavMesh *CreateNavMesh(unsigned char *data, size_t dataSize, bool copy, char *error, size_t errorSize) {
+	dtStatus status = 0;
+	if (!copy && ((uintptr_t)data & 3) != 0) {
+		snprintf(error, errorSize, "Navmesh data must be 4 byte aligned");
+		return NULL;
+	}
+	if (IsTileSet(data, dataSize)) {
+		TileSet tileSet;
+		if (!tileSet.Open(data, dataSize, error, errorSize)) {
+			return NULL;
+		}
+		return CreateNavMeshFromTileSet(tileSet, !copy, error, errorSize);
+	}
+	// Headers are copied out so unaligned input can still be loaded by copy.
+	NavMeshSetHeader header;
+	if (dataSize >= sizeof(NavMeshSetHeader)) {
+		memcpy(&header, data, sizeof(NavMeshSetHeader));
+	} else {
+		header.magic = 0;
+	}
+	if (header.magic == NAVMESHSET_MAGIC) {
+		if (header.version != NAVMESHSET_VERSION) {
+			snprintf(error, errorSize, "Unsupported tile set version %d", header.version);
+			return NULL;
+		}
+		dtNavMesh *navMesh = dtAllocNavMesh();
+		if (!navMesh) {
+			snprintf(error, errorSize, "dtAllocNavMesh");
+			return NULL;
+		}
+		status = navMesh->init(&header.params);
+		if (dtStatusFailed(status)) {
+			dtFreeNavMesh(navMesh);
+			snprintf(error, errorSize, "dtNavMesh->init 0x%x", status);
+			return NULL;
+		}
+		size_t offset = sizeof(NavMeshSetHeader);
+		for (int index = 0; index < header.numTiles; index++) {
+			if (dataSize - offset < sizeof(NavMeshTileHeader)) {
+				dtFreeNavMesh(navMesh);
+				snprintf(error, errorSize, "Truncated tile set");
+				return NULL;
+			}
+			NavMeshTileHeader tileHeader;
+			memcpy(&tileHeader, data + offset, sizeof(NavMeshTileHeader));
+			offset += sizeof(NavMeshTileHeader);
+			if (!tileHeader.tileRef || tileHeader.dataSize <= 0) {
+				break;
+			}
+			if (dataSize - offset < (size_t)tileHeader.dataSize) {
+				dtFreeNavMesh(navMesh);
+				snprintf(error, errorSize, "Truncated tile set");
+				return NULL;
+			}
+			unsigned char *tileData = data + offset;
+			int tileFlags = 0;
+			if (copy) {
+				tileData = (unsigned char*)dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM);
+				if (!tileData) {
+					dtFreeNavMesh(navMesh);
+					snprintf(error, errorSize, "Out of Memory");
+					return NULL;
+				}
+				memcpy(tileData, data + offset, tileHeader.dataSize);
+				tileFlags = DT_TILE_FREE_DATA;
+			}
+			status = navMesh->addTile(tileData, tileHeader.dataSize, tileFlags, tileHeader.tileRef, 0);
+			if (dtStatusFailed(status) && copy) {
+				dtFree(tileData);
+			}
+			offset += tileHeader.dataSize;
+		}
+		return navMesh;
+	}
+	if (dataSize < sizeof(dtMeshHeader)) {
+		snprintf(error, errorSize, "dtNavMesh->init 0x%x", DT_FAILURE | DT_WRONG_MAGIC);
+		return NULL;
+	}
+	unsigned char *tileData = data;
+	int tileFlags = 0;
+	if (copy) {
+		tileData = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+		if (!tileData) {
+			snprintf(error, errorSize, "Out of Memory");
+			return NULL;
+		}
+		memcpy(tileData, data, dataSize);
+		tileFlags = DT_TILE_FREE_DATA;
+	}
+	dtNavMesh *navMesh = dtAllocNavMesh();
+	if (!navMesh) {
+		if (copy) {
+			dtFree(tileData);
+		}
+		snprintf(error, errorSize, "dtAllocNavMesh");
+		return NULL;
+	}
+	status = navMesh->init(tileData, (int)dataSize, tileFlags);
+	if (dtStatusFailed(status)) {
+		if (copy) {
+			dtFree(tileData);
+		}
+		dtFreeNavMesh(navMesh);
+		snprintf(error, errorSize, "dtNavMesh->init 0x%x", status);
+		return NULL;
+	}
+	return navMesh;
+}
+
+SharedNavMesh *LoadNavMeshFile(const char *path, char *error, size_t errorSize) {
+	dtStatus status = 0;
+	dtNavMesh *navMesh = NULL;
+
+	if (IsTileSetFile(path)) {
+		TileSet tileSet;
+		if (!tileSet.Open(path, error, errorSize)) {
+			return NULL;
+		}
+		navMesh = CreateNavMeshFromTileSet(tileSet, false, error, errorSize);
+		return navMesh ? new SharedNavMesh(navMesh) : NULL;
+	}
+
+	Sample sample;
+	navMesh = sample.loadAll(path);
+	if (navMesh) {
+		return new SharedNavMesh(navMesh);
+	}
+
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		snprintf(error, errorSize, "No such file or directory");
+		return NULL;
+	}
+	if (fseek(fp, 0, SEEK_END) != 0) {
+		fclose(fp);
+		snprintf(error, errorSize, "fseek");
+		return NULL;
+	}
+	long bufferSize = ftell(fp);
+	if (bufferSize < 0) {
+		fclose(fp);
+		snprintf(error, errorSize, "ftell");
+		return NULL;
+	}
+	if (fseek(fp, 0, SEEK_SET) != 0) {
+		fclose(fp);
+		snprintf(error, errorSize, "fseek");
+		return NULL;
+	}
+	unsigned char *buffer = (unsigned char*)dtAlloc(bufferSize, DT_ALLOC_PERM);
+	if (!buffer) {
+		fclose(fp);
+		snprintf(error, errorSize, "Out of Memory");
+		return NULL;
+	}
+	size_t readSize = fread(buffer, bufferSize, 1, fp);
+	fclose(fp);
+	if (readSize != 1) {
+		dtFree(buffer);
+		snprintf(error, errorSize, "fread");
+		return NULL;
+	}
+	navMesh = dtAllocNavMesh();
+	if (!navMesh) {
+		dtFree(buffer);
+		snprintf(error, errorSize, "dtAllocNavMesh");
+		return NULL;
+	}
+	status = navMesh->init(buffer, bufferSize, DT_TILE_FREE_DATA);
+	if (dtStatusFailed(status)) {
+		dtFree(buffer);
+		dtFreeNavMesh(navMesh);
+		snprintf(error, errorSize, "dtNavMesh->init 0x%x", status);
+		return NULL;
+	}
+	return new SharedNavMesh(navMesh);
+}
+
+struct MappedFile {
+	void *address;
+	size_t size;
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+};
+
+static void UnmapFile(void *releaseData) {
+	MappedFile *mappedFile = (MappedFile*)releaseData;
+#ifdef _WIN32
+	UnmapViewOfFile(mappedFile->address);
+	CloseHandle(mappedFile->mapping);
+#else
+	munmap(mappedFile->address, mappedFile->size);
+#endif
+	delete mappedFile;
+}
+
+SharedNavMesh *MapNavMeshFile(const char *path, char *error, size_t errorSize) {
+	MappedFile *mappedFile = new MappedFile();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		delete mappedFile;
+		snprintf(error, errorSize, "No such file or directory");
+		return NULL;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		delete mappedFile;
+		snprintf(error, errorSize, "GetFileSizeEx");
+		return NULL;
+	}
+	mappedFile->size = (size_t)fileSize.QuadPart;
+	mappedFile->mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mappedFile->mapping) {
+		delete mappedFile;
+		snprintf(error, errorSize, "CreateFileMapping");
+		return NULL;
+	}
+	mappedFile->address = MapViewOfFile(mappedFile->mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (!mappedFile->address) {
+		CloseHandle(mappedFile->mapping);
+		delete mappedFile;
+		snprintf(error, errorSize, "MapViewOfFile");
+		return NULL;
+	}
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		delete mappedFile;
+		snprintf(error, errorSize, "No such file or directory");
+		return NULL;
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+		close(fd);
+		delete mappedFile;
+		snprintf(error, errorSize, "fstat");
+		return NULL;
+	}
+	mappedFile->size = (size_t)fileStat.st_size;
+	// Private writable mapping: Detour stores tile links in the tile data, and
+	// only the pages it touches get copied.
+	mappedFile->address = mmap(NULL, mappedFile->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mappedFile->address == MAP_FAILED) {
+		delete mappedFile;
+		snprintf(error, errorSize, "mmap");
+		return NULL;
+	}
+#endif
+	dtNavMesh *navMesh = CreateNavMesh((unsigned char*)mappedFile->address, mappedFile->size, false, error, errorSize);
+	if (!navMesh) {
+		UnmapFile(mappedFile);
+		return NULL;
+	}
+	return new SharedNavMesh(navMesh, UnmapFile, mappedFile);
+}
+
+SharedNavMesh *StreamNavMeshFile(const char *path, size_t budget, int margin, char *error, size_t errorSize) {
+	if (!IsTileSetFile(path)) {
+		snprintf(error, errorSize, "Streaming needs a tile set file, see convertNavMesh");
+		return NULL;
+	}
+	dtNavMesh *navMesh = dtAllocNavMesh();
+	if (!navMesh) {
+		snprintf(error, errorSize, "dtAllocNavMesh");
+		return NULL;
+	}
+	TileStreamer *streamer = new TileStreamer(budget, margin);
+	if (!streamer->Open(path, navMesh, error, errorSize)) {
+		delete streamer;
+		dtFreeNavMesh(navMesh);
+		return NULL;
+	}
+	return new SharedNavMesh(navMesh, streamer);
+}
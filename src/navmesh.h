@@ -0,0 +1,69 @@
+#ifndef NAVQUERY_NAVMESH_H
+#define NAVQUERY_NAVMESH_H
+
+#include <stddef.h>
+#include <atomic>
+
+#include "DetourNavMesh.h"
+
+class TileStreamer;
+
+// A dtNavMesh shared by NavMesh and NavQuery objects and by the threadpool
+// workers running their queries. The mesh is freed with the last reference,
+// then release(releaseData) frees memory the tiles borrowed, if any.
+class SharedNavMesh {
+public:
+	explicit SharedNavMesh(dtNavMesh *navMesh, void (*release)(void *releaseData) = NULL, void *releaseData = NULL);
+	// A streaming mesh; the streamer is deleted after the mesh.
+	SharedNavMesh(dtNavMesh *navMesh, TileStreamer *streamer);
+
+	void Ref();
+	void Unref();
+
+	inline dtNavMesh *Get() const { return m_navMesh; }
+	// NULL unless tiles are streamed in by queries, see StreamNavMeshFile.
+	inline TileStreamer *GetStreamer() const { return m_streamer; }
+
+	// Bumped whenever poly flags or areas change, results derived from the
+	// mesh earlier may be stale.
+	inline unsigned int GetVersion() const { return m_version.load(); }
+	inline void BumpVersion() { m_version.fetch_add(1); }
+
+private:
+	~SharedNavMesh();
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	SharedNavMesh(const SharedNavMesh&);
+	SharedNavMesh& operator=(const SharedNavMesh&);
+
+	dtNavMesh *m_navMesh;
+	void (*m_release)(void *releaseData);
+	void *m_releaseData;
+	TileStreamer *m_streamer;
+	std::atomic<int> m_refs;
+	std::atomic<unsigned int> m_version;
+};
+
+// Builds a dtNavMesh from a tile set (see tileset.h), RecastDemo tile set
+// (MSET) or raw single tile image in memory. With copy set every tile is
+// copied into dtAlloc memory, otherwise Detour uses data in place: it must be
+// 4 byte aligned, outlive the mesh and stay untouched, as Detour writes tile
+// links into it. Returns NULL and writes a message to error on failure.
+dtNavMesh *CreateNavMesh(unsigned char *data, size_t dataSize, bool copy, char *error, size_t errorSize);
+
+// Loads a tile set, RecastDemo tile set (MSET) or raw single tile file.
+// Returns NULL and writes a message to error on failure.
+SharedNavMesh *LoadNavMeshFile(const char *path, char *error, size_t errorSize);
+
+// Maps a navmesh file copy-on-write and hands the mapped pages to Detour
+// without DT_TILE_FREE_DATA. Pages Detour never writes to stay shared with
+// the page cache and with other processes mapping the same file.
+SharedNavMesh *MapNavMeshFile(const char *path, char *error, size_t errorSize);
+
+// Opens a tile set file without loading any tile. Queries stream in the tiles
+// they touch and the least recently used ones are dropped once their data
+// exceeds budget bytes. Path searches start with margin tiles around the box
+// spanned by their end points.
+SharedNavMesh *StreamNavMeshFile(const char *path, size_t budget, int margin, char *error, size_t errorSize);
+
+#endif // NAVQUERY_NAVMESH_H
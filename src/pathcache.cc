@@ -0,0 +1,116 @@
+#include <string.h>
+
+#include "pathcache.h"
+
+PathCache::PathCache(int capacity) : m_capacity(capacity), m_navMesh(NULL) {
+	memset(&m_stats, 0, sizeof(m_stats));
+	uv_mutex_init(&m_mutex);
+}
+
+PathCache::~PathCache() {
+	uv_mutex_destroy(&m_mutex);
+}
+
+void PathCache::Reset(const dtNavMesh *navMesh) {
+	uv_mutex_lock(&m_mutex);
+	m_navMesh = navMesh;
+	m_entries.clear();
+	m_index.clear();
+	m_stats.size = 0;
+	uv_mutex_unlock(&m_mutex);
+}
+
+bool PathCache::Lookup(const dtNavMesh *navMesh, unsigned int version, dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash,
+	dtPolyRef *path, int *pathCount, int maxPath) {
+	Key key;
+	key.startRef = startRef;
+	key.endRef = endRef;
+	key.filterHash = filterHash;
+	uv_mutex_lock(&m_mutex);
+	std::map<Key, EntryList::iterator>::iterator it = navMesh == m_navMesh ? m_index.find(key) : m_index.end();
+	if (it == m_index.end()) {
+		m_stats.misses++;
+		uv_mutex_unlock(&m_mutex);
+		return false;
+	}
+	Entry &entry = *it->second;
+	bool valid = entry.version == version && (int)entry.path.size() <= maxPath;
+	for (size_t index = 0; valid && index < entry.path.size(); index++) {
+		valid = navMesh->isValidPolyRef(entry.path[index]);
+	}
+	if (!valid) {
+		m_entries.erase(it->second);
+		m_index.erase(it);
+		m_stats.invalidations++;
+		m_stats.misses++;
+		m_stats.size--;
+		uv_mutex_unlock(&m_mutex);
+		return false;
+	}
+	m_entries.splice(m_entries.begin(), m_entries, it->second);
+	memcpy(path, &entry.path[0], entry.path.size() * sizeof(dtPolyRef));
+	*pathCount = (int)entry.path.size();
+	m_stats.hits++;
+	uv_mutex_unlock(&m_mutex);
+	return true;
+}
+
+void PathCache::Store(const dtNavMesh *navMesh, unsigned int version, dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash,
+	const dtPolyRef *path, int pathCount) {
+	if (m_capacity <= 0 || pathCount <= 0) {
+		return;
+	}
+	Key key;
+	key.startRef = startRef;
+	key.endRef = endRef;
+	key.filterHash = filterHash;
+	uv_mutex_lock(&m_mutex);
+	if (navMesh != m_navMesh) {
+		uv_mutex_unlock(&m_mutex);
+		return;
+	}
+	std::map<Key, EntryList::iterator>::iterator it = m_index.find(key);
+	if (it != m_index.end()) {
+		m_entries.erase(it->second);
+		m_index.erase(it);
+		m_stats.size--;
+	}
+	m_entries.push_front(Entry());
+	Entry &entry = m_entries.front();
+	entry.key = key;
+	entry.version = version;
+	entry.path.assign(path, path + pathCount);
+	m_index[key] = m_entries.begin();
+	m_stats.size++;
+	while (m_stats.size > m_capacity) {
+		m_index.erase(m_entries.back().key);
+		m_entries.pop_back();
+		m_stats.size--;
+	}
+	uv_mutex_unlock(&m_mutex);
+}
+
+PathCacheStats PathCache::GetStats() {
+	uv_mutex_lock(&m_mutex);
+	PathCacheStats stats = m_stats;
+	uv_mutex_unlock(&m_mutex);
+	return stats;
+}
+
+// FNV-1a over the flags and area costs.
+unsigned int HashQueryFilter(const dtQueryFilter *filter) {
+	unsigned int hash = 2166136261u;
+	unsigned short flags[2] = { filter->getIncludeFlags(), filter->getExcludeFlags() };
+	const unsigned char *bytes = (const unsigned char*)flags;
+	for (size_t index = 0; index < sizeof(flags); index++) {
+		hash = (hash ^ bytes[index]) * 16777619u;
+	}
+	for (int area = 0; area < DT_MAX_AREAS; area++) {
+		float cost = filter->getAreaCost(area);
+		bytes = (const unsigned char*)&cost;
+		for (size_t index = 0; index < sizeof(cost); index++) {
+			hash = (hash ^ bytes[index]) * 16777619u;
+		}
+	}
+	return hash;
+}
@@ -0,0 +1,78 @@
+#ifndef NAVQUERY_PATHCACHE_H
+#define NAVQUERY_PATHCACHE_H
+
+#include <uv.h>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+struct PathCacheStats {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long invalidations;
+	int size;
+};
+
+// LRU cache of findPath polygon corridors keyed by start poly, end poly and
+// filter hash. Start and end positions are not part of the key, callers get
+// the corridor found for the first positions seen and straighten it for
+// their own. An entry is dropped when a poly on its corridor is no longer
+// valid, i.e. its tile was removed or replaced and the salt changed, or when
+// the flags version of the mesh moved on. Safe to use from several threads.
+class PathCache {
+public:
+	explicit PathCache(int capacity);
+	~PathCache();
+
+	// Forgets all entries and ties the cache to navMesh.
+	void Reset(const dtNavMesh *navMesh);
+
+	// Copies a valid cached corridor into path and returns true on a hit.
+	bool Lookup(const dtNavMesh *navMesh, unsigned int version, dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash,
+		dtPolyRef *path, int *pathCount, int maxPath);
+
+	void Store(const dtNavMesh *navMesh, unsigned int version, dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash,
+		const dtPolyRef *path, int pathCount);
+
+	PathCacheStats GetStats();
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	PathCache(const PathCache&);
+	PathCache& operator=(const PathCache&);
+
+	struct Key {
+		dtPolyRef startRef;
+		dtPolyRef endRef;
+		unsigned int filterHash;
+
+		bool operator<(const Key &other) const {
+			if (startRef != other.startRef) return startRef < other.startRef;
+			if (endRef != other.endRef) return endRef < other.endRef;
+			return filterHash < other.filterHash;
+		}
+	};
+
+	struct Entry {
+		Key key;
+		unsigned int version;
+		std::vector<dtPolyRef> path;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	int m_capacity;
+	const dtNavMesh *m_navMesh;
+	EntryList m_entries;
+	std::map<Key, EntryList::iterator> m_index;
+	PathCacheStats m_stats;
+	uv_mutex_t m_mutex;
+};
+
+// Hash of everything in a dtQueryFilter that affects findPath.
+unsigned int HashQueryFilter(const dtQueryFilter *filter);
+
+#endif // NAVQUERY_PATHCACHE_H
@@ -0,0 +1,333 @@
+#include <float.h>
+#include <stdlib.h>
+#include <functional>
+#include <queue>
+
+#include "DetourCommon.h"
+#include "portalgraph.h"
+
+// Closer end points are searched flat, the detour over border polygons
+// would cost more than it saves.
+static const int MIN_TILE_DISTANCE = 2;
+
+// Tiles around the abstract path the refining findPath may use. Narrower
+// bands miss the shortcuts a flat search takes between border polygons.
+static const int BAND_RING = 2;
+
+// Same heuristic scale as dtNavMeshQuery::findPath.
+static const float H_SCALE = 0.999f;
+
+typedef std::pair<float, int> HeapEntry;
+typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > MinHeap;
+
+// dtQueryFilter::passFilter and getCost are only defined inside Detour, this
+// mirrors the default implementation.
+static inline bool PassFilter(const dtQueryFilter *filter, const dtPoly *poly) {
+	return (poly->flags & filter->getIncludeFlags()) != 0 && (poly->flags & filter->getExcludeFlags()) == 0;
+}
+
+static void PolyCenter(const dtMeshTile *tile, const dtPoly *poly, float *center) {
+	dtVset(center, 0.0f, 0.0f, 0.0f);
+	for (int index = 0; index < poly->vertCount; index++) {
+		dtVadd(center, center, &tile->verts[poly->verts[index] * 3]);
+	}
+	dtVscale(center, center, 1.0f / poly->vertCount);
+}
+
+static void EdgeMidPoint(const dtMeshTile *tile, const dtPoly *poly, int edge, float *mid) {
+	const float *va = &tile->verts[poly->verts[edge] * 3];
+	const float *vb = &tile->verts[poly->verts[(edge + 1) % poly->vertCount] * 3];
+	dtVlerp(mid, va, vb, 0.5f);
+}
+
+// Cost of moving from fromPos on poly through the edge of link to the
+// center of the linked poly.
+static float LinkCost(const dtQueryFilter *filter, const dtMeshTile *tile, const dtPoly *poly, const float *fromPos,
+	const dtLink &link, const dtMeshTile *toTile, const dtPoly *toPoly) {
+	float mid[3];
+	float toCenter[3];
+	EdgeMidPoint(tile, poly, link.edge, mid);
+	PolyCenter(toTile, toPoly, toCenter);
+	return dtVdist(fromPos, mid) * filter->getAreaCost(poly->getArea())
+		+ dtVdist(mid, toCenter) * filter->getAreaCost(toPoly->getArea());
+}
+
+// Dijkstra over the polys of one tile that pass filter, starting at poly
+// index source at sourcePos. Writes the cost to reach each poly of the tile
+// into costs, FLT_MAX where it is not reachable inside the tile.
+static void SearchTile(const dtNavMesh *navMesh, const dtMeshTile *tile, const dtQueryFilter *filter, int source, const float *sourcePos, std::vector<float> &costs) {
+	const dtPolyRef base = navMesh->getPolyRefBase(tile);
+	const unsigned int tileIndex = navMesh->decodePolyIdTile(base);
+	costs.assign(tile->header->polyCount, FLT_MAX);
+	costs[source] = 0.0f;
+	MinHeap heap;
+	heap.push(HeapEntry(0.0f, source));
+	while (!heap.empty()) {
+		const HeapEntry entry = heap.top();
+		heap.pop();
+		const int current = entry.second;
+		if (entry.first > costs[current]) {
+			continue;
+		}
+		const dtPoly *poly = &tile->polys[current];
+		float pos[3];
+		if (current == source) {
+			dtVcopy(pos, sourcePos);
+		} else {
+			PolyCenter(tile, poly, pos);
+		}
+		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next) {
+			const dtLink &link = tile->links[k];
+			if (!link.ref || navMesh->decodePolyIdTile(link.ref) != tileIndex) {
+				continue;
+			}
+			const int neighbour = (int)navMesh->decodePolyIdPoly(link.ref);
+			const dtPoly *neighbourPoly = &tile->polys[neighbour];
+			if (!PassFilter(filter, neighbourPoly)) {
+				continue;
+			}
+			const float cost = costs[current] + LinkCost(filter, tile, poly, pos, link, tile, neighbourPoly);
+			if (cost < costs[neighbour]) {
+				costs[neighbour] = cost;
+				heap.push(HeapEntry(cost, neighbour));
+			}
+		}
+	}
+}
+
+static int TileDistance(const dtMeshTile *a, const dtMeshTile *b) {
+	return dtMax(abs(a->header->x - b->header->x), abs(a->header->y - b->header->y));
+}
+
+// Confines findPath to a set of tiles, on top of the bound the caller set.
+class TileBand : public dtPathCostBound {
+public:
+	TileBand(const dtNavMesh *navMesh, const dtPathCostBound *bound) : m_navMesh(navMesh), m_bound(bound), m_tiles(navMesh->getMaxTiles(), 0) {
+	}
+
+	// Adds the tile of ref and the tiles up to ring tiles around it.
+	void Add(dtPolyRef ref, int ring) {
+		const unsigned int tileIndex = m_navMesh->decodePolyIdTile(ref);
+		if (m_tiles[tileIndex] > ring) {
+			return;
+		}
+		m_tiles[tileIndex] = (char)(ring + 1);
+		const dtMeshTile *tile = m_navMesh->getTile((int)tileIndex);
+		const dtMeshTile *neighbours[MAX_LAYERS];
+		for (int y = tile->header->y - ring; y <= tile->header->y + ring; y++) {
+			for (int x = tile->header->x - ring; x <= tile->header->x + ring; x++) {
+				const int count = m_navMesh->getTilesAt(x, y, neighbours, MAX_LAYERS);
+				for (int index = 0; index < count; index++) {
+					char &added = m_tiles[m_navMesh->decodePolyIdTile(m_navMesh->getPolyRefBase(neighbours[index]))];
+					added = dtMax(added, (char)1);
+				}
+			}
+		}
+	}
+
+	virtual float getLowerBound(dtPolyRef ref, dtPolyRef endRef) const {
+		if (!m_tiles[m_navMesh->decodePolyIdTile(ref)]) {
+			return FLT_MAX;
+		}
+		return m_bound ? m_bound->getLowerBound(ref, endRef) : 0.0f;
+	}
+
+private:
+	static const int MAX_LAYERS = 32;
+
+	const dtNavMesh *m_navMesh;
+	const dtPathCostBound *m_bound;
+	// Per tile index, ring + 1 once added with its neighbours, 1 as a
+	// neighbour only, 0 outside the band.
+	std::vector<char> m_tiles;
+};
+
+PortalGraph::PortalGraph() : m_navMesh(NULL), m_version(0), m_filterHash(0) {
+}
+
+int PortalGraph::FindNode(dtPolyRef ref) const {
+	std::unordered_map<dtPolyRef, int>::const_iterator it = m_index.find(ref);
+	return it == m_index.end() ? -1 : it->second;
+}
+
+void PortalGraph::Build(const dtNavMesh *navMesh, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash) {
+	m_navMesh = navMesh;
+	m_version = version;
+	m_filterHash = filterHash;
+	m_refs.clear();
+	m_positions.clear();
+	m_index.clear();
+	m_edgeFirst.clear();
+	m_edgeTargets.clear();
+	m_edgeCosts.clear();
+	const int maxTiles = navMesh->getMaxTiles();
+	m_tileFirst.assign(maxTiles + 1, 0);
+
+	// Border polys become nodes.
+	for (int tileIndex = 0; tileIndex < maxTiles; tileIndex++) {
+		m_tileFirst[tileIndex] = (int)m_refs.size();
+		const dtMeshTile *tile = navMesh->getTile(tileIndex);
+		if (!tile || !tile->header) {
+			continue;
+		}
+		const dtPolyRef base = navMesh->getPolyRefBase(tile);
+		for (int polyIndex = 0; polyIndex < tile->header->polyCount; polyIndex++) {
+			const dtPoly *poly = &tile->polys[polyIndex];
+			if (!PassFilter(filter, poly)) {
+				continue;
+			}
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next) {
+				const dtLink &link = tile->links[k];
+				if (link.ref && navMesh->decodePolyIdTile(link.ref) != (unsigned int)tileIndex) {
+					const dtPolyRef ref = base | (dtPolyRef)polyIndex;
+					float center[3];
+					PolyCenter(tile, poly, center);
+					m_index[ref] = (int)m_refs.size();
+					m_refs.push_back(ref);
+					m_positions.insert(m_positions.end(), center, center + 3);
+					break;
+				}
+			}
+		}
+	}
+	m_tileFirst[maxTiles] = (int)m_refs.size();
+
+	// Edges inside each tile from one search per border poly, then the links
+	// across the tile edge.
+	std::vector<float> costs;
+	m_edgeFirst.reserve(m_refs.size() + 1);
+	for (int tileIndex = 0; tileIndex < maxTiles; tileIndex++) {
+		const dtMeshTile *tile = navMesh->getTile(tileIndex);
+		for (int node = m_tileFirst[tileIndex]; node < m_tileFirst[tileIndex + 1]; node++) {
+			m_edgeFirst.push_back((int)m_edgeTargets.size());
+			const int polyIndex = (int)navMesh->decodePolyIdPoly(m_refs[node]);
+			const dtPoly *poly = &tile->polys[polyIndex];
+			SearchTile(navMesh, tile, filter, polyIndex, &m_positions[node * 3], costs);
+			for (int other = m_tileFirst[tileIndex]; other < m_tileFirst[tileIndex + 1]; other++) {
+				const float cost = costs[navMesh->decodePolyIdPoly(m_refs[other])];
+				if (other != node && cost < FLT_MAX) {
+					m_edgeTargets.push_back(other);
+					m_edgeCosts.push_back(cost);
+				}
+			}
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next) {
+				const dtLink &link = tile->links[k];
+				if (!link.ref || navMesh->decodePolyIdTile(link.ref) == (unsigned int)tileIndex) {
+					continue;
+				}
+				const int other = FindNode(link.ref);
+				if (other < 0) {
+					continue;
+				}
+				const dtMeshTile *otherTile = NULL;
+				const dtPoly *otherPoly = NULL;
+				navMesh->getTileAndPolyByRefUnsafe(link.ref, &otherTile, &otherPoly);
+				m_edgeTargets.push_back(other);
+				m_edgeCosts.push_back(LinkCost(filter, tile, poly, &m_positions[node * 3], link, otherTile, otherPoly));
+			}
+		}
+	}
+	m_edgeFirst.push_back((int)m_edgeTargets.size());
+}
+
+bool PortalGraph::FindPath(dtNavMeshQuery *navQuery, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash,
+	dtPolyRef startRef, dtPolyRef endRef, const float *startPos, const float *endPos,
+	dtPolyRef *path, int *pathCount, int maxPath, dtStatus *status) const {
+	const dtNavMesh *navMesh = navQuery->getAttachedNavMesh();
+	if (navMesh != m_navMesh || version != m_version || filterHash != m_filterHash || maxPath <= 0) {
+		return false;
+	}
+	if (!navMesh->isValidPolyRef(startRef) || !navMesh->isValidPolyRef(endRef)) {
+		return false;
+	}
+	const dtMeshTile *startTile = NULL;
+	const dtPoly *startPoly = NULL;
+	const dtMeshTile *endTile = NULL;
+	const dtPoly *endPoly = NULL;
+	navMesh->getTileAndPolyByRefUnsafe(startRef, &startTile, &startPoly);
+	navMesh->getTileAndPolyByRefUnsafe(endRef, &endTile, &endPoly);
+	if (TileDistance(startTile, endTile) < MIN_TILE_DISTANCE) {
+		return false;
+	}
+	const unsigned int startTileIndex = navMesh->decodePolyIdTile(startRef);
+	const unsigned int endTileIndex = navMesh->decodePolyIdTile(endRef);
+
+	// Costs from the start to the border of its tile and from the border of
+	// the end tile to the end. Link costs are symmetric, so the second search
+	// runs from the end.
+	std::vector<float> startCosts;
+	std::vector<float> endCosts;
+	SearchTile(navMesh, startTile, filter, (int)navMesh->decodePolyIdPoly(startRef), startPos, startCosts);
+	SearchTile(navMesh, endTile, filter, (int)navMesh->decodePolyIdPoly(endRef), endPos, endCosts);
+
+	// A* over the border nodes. The goal is a virtual node behind the border
+	// of the end tile.
+	const int goal = -1;
+	std::unordered_map<int, float> best;
+	std::unordered_map<int, int> parents;
+	float goalCost = FLT_MAX;
+	int goalParent = -1;
+	MinHeap heap;
+	for (int node = m_tileFirst[startTileIndex]; node < m_tileFirst[startTileIndex + 1]; node++) {
+		const float cost = startCosts[navMesh->decodePolyIdPoly(m_refs[node])];
+		if (cost < FLT_MAX) {
+			best[node] = cost;
+			parents[node] = -1;
+			heap.push(HeapEntry(cost + dtVdist(&m_positions[node * 3], endPos) * H_SCALE, node));
+		}
+	}
+	while (!heap.empty()) {
+		const HeapEntry entry = heap.top();
+		heap.pop();
+		const int node = entry.second;
+		if (node == goal) {
+			break;
+		}
+		const float cost = best[node];
+		if (entry.first > cost + dtVdist(&m_positions[node * 3], endPos) * H_SCALE) {
+			continue;
+		}
+		if (navMesh->decodePolyIdTile(m_refs[node]) == endTileIndex) {
+			const float endCost = endCosts[navMesh->decodePolyIdPoly(m_refs[node])];
+			if (endCost < FLT_MAX && cost + endCost < goalCost) {
+				goalCost = cost + endCost;
+				goalParent = node;
+				heap.push(HeapEntry(goalCost, goal));
+			}
+		}
+		for (int edge = m_edgeFirst[node]; edge < m_edgeFirst[node + 1]; edge++) {
+			const int target = m_edgeTargets[edge];
+			const float targetCost = cost + m_edgeCosts[edge];
+			std::unordered_map<int, float>::iterator it = best.find(target);
+			if (it != best.end() && it->second <= targetCost) {
+				continue;
+			}
+			best[target] = targetCost;
+			parents[target] = node;
+			heap.push(HeapEntry(targetCost + dtVdist(&m_positions[target * 3], endPos) * H_SCALE, target));
+		}
+	}
+	if (goalParent < 0) {
+		return false;
+	}
+	std::vector<int> nodes;
+	for (int node = goalParent; node >= 0; node = parents[node]) {
+		nodes.push_back(node);
+	}
+
+	// Refine: a findPath confined to the tiles the abstract path crosses and
+	// those around them. The abstract path runs through the centers of border
+	// polygons, the confined search takes the way through them a flat search
+	// would.
+	const dtPathCostBound *bound = navQuery->getPathCostBound();
+	TileBand band(navMesh, bound);
+	band.Add(startRef, BAND_RING);
+	band.Add(endRef, BAND_RING);
+	for (size_t index = 0; index < nodes.size(); index++) {
+		band.Add(m_refs[nodes[index]], BAND_RING);
+	}
+	navQuery->setPathCostBound(&band);
+	*status = navQuery->findPath(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+	navQuery->setPathCostBound(bound);
+	return dtStatusSucceed(*status) && !dtStatusDetail(*status, DT_PARTIAL_RESULT) && *pathCount > 0 && path[*pathCount - 1] == endRef;
+}
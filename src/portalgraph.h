@@ -0,0 +1,68 @@
+#ifndef NAVQUERY_PORTALGRAPH_H
+#define NAVQUERY_PORTALGRAPH_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+// Abstract graph for hierarchical (HPA*) path searches over tiled meshes.
+// Its nodes are the border polygons of each tile, those with a dtLink into
+// another tile. Border polygons of one tile are joined by the cost of the
+// cheapest way between them inside the tile, and linked border polygons of
+// neighbouring tiles by the cost of crossing the tile edge.
+//
+// A long search first finds the way from the start tile to the end tile on
+// this graph, then runs findPath confined to the tiles that way crosses and
+// a couple of tiles around them. Paths are those of a flat search unless a
+// cheaper way leaves that band.
+//
+// The graph is built for one mesh, flags version and filter; FindPath
+// declines to run once any of them differs. It is never modified after
+// Build, so any number of threads may search it at once.
+class PortalGraph {
+public:
+	PortalGraph();
+
+	// Builds the graph over every tile of navMesh for the flags version and
+	// the include / exclude flags and area costs of filter.
+	void Build(const dtNavMesh *navMesh, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash);
+
+	inline int GetNodeCount() const { return (int)m_refs.size(); }
+	inline int GetEdgeCount() const { return (int)m_edgeTargets.size(); }
+
+	// Searches from startRef to endRef when their tiles are at least two
+	// apart and the graph matches the mesh of navQuery, version and filterHash.
+	// Returns false when it does not apply or finds no complete way, the
+	// caller then runs a flat findPath. Otherwise the corridor is in path and status is
+	// set like findPath would.
+	bool FindPath(dtNavMeshQuery *navQuery, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash,
+		dtPolyRef startRef, dtPolyRef endRef, const float *startPos, const float *endPos,
+		dtPolyRef *path, int *pathCount, int maxPath, dtStatus *status) const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	PortalGraph(const PortalGraph&);
+	PortalGraph& operator=(const PortalGraph&);
+
+	int FindNode(dtPolyRef ref) const;
+
+	const dtNavMesh *m_navMesh;
+	unsigned int m_version;
+	unsigned int m_filterHash;
+
+	// Nodes are numbered tile by tile, the nodes of tile index i are
+	// m_tileFirst[i] up to m_tileFirst[i + 1].
+	std::vector<dtPolyRef> m_refs;
+	std::vector<float> m_positions;
+	std::vector<int> m_tileFirst;
+	std::unordered_map<dtPolyRef, int> m_index;
+
+	// Outgoing edges of node i are m_edgeFirst[i] up to m_edgeFirst[i + 1].
+	std::vector<int> m_edgeFirst;
+	std::vector<int> m_edgeTargets;
+	std::vector<float> m_edgeCosts;
+};
+
+#endif // NAVQUERY_PORTALGRAPH_H
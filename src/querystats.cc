@@ -0,0 +1,114 @@
+#include <string.h>
+
+#include "DetourNode.h"
+#include "querystats.h"
+
+QueryStats::QueryStats() {
+	memset(m_entries, 0, sizeof(m_entries));
+	uv_mutex_init(&m_mutex);
+}
+
+QueryStats::~QueryStats() {
+	uv_mutex_destroy(&m_mutex);
+}
+
+void QueryStats::Record(QueryStatsApi api, unsigned long long nanos, unsigned int nodes, unsigned int pushes,
+	unsigned int outOfNodes, unsigned int partialResults, unsigned int failures) {
+	unsigned long long micros = nanos / 1000;
+	int bucket = 0;
+	while (micros > 0 && bucket < QUERY_STATS_BUCKETS - 1) {
+		micros >>= 1;
+		bucket++;
+	}
+	uv_mutex_lock(&m_mutex);
+	QueryStatsEntry &entry = m_entries[api];
+	entry.count++;
+	entry.nodes += nodes;
+	entry.pushes += pushes;
+	entry.outOfNodes += outOfNodes;
+	entry.partialResults += partialResults;
+	entry.failures += failures;
+	entry.totalNanos += nanos;
+	if (nanos > entry.maxNanos) {
+		entry.maxNanos = nanos;
+	}
+	entry.histogram[bucket]++;
+	uv_mutex_unlock(&m_mutex);
+}
+
+void QueryStats::Snapshot(QueryStatsEntry *entries) {
+	uv_mutex_lock(&m_mutex);
+	memcpy(entries, m_entries, sizeof(m_entries));
+	uv_mutex_unlock(&m_mutex);
+}
+
+void QueryStats::Reset() {
+	uv_mutex_lock(&m_mutex);
+	memset(m_entries, 0, sizeof(m_entries));
+	uv_mutex_unlock(&m_mutex);
+}
+
+const char *QueryStats::GetApiName(QueryStatsApi api) {
+	static const char *names[QUERY_STATS_API_COUNT] = {
+		"findNearestPoly",
+		"findNearestPolyBatch",
+		"findRandomPoint",
+		"findRandomPoints",
+		"findRandomPointAroundCircle",
+		"findStraightPath",
+		"findStraightPathAsync",
+		"findStraightPathBatch",
+		"raycast",
+		"moveAlongSurface",
+		"findDistanceToWall",
+		"findPolysAroundCircle",
+		"findLocalNeighbourhood",
+	};
+	return names[api];
+}
+
+// The pools and open lists only exist once the query has been initialised.
+// The back ones are allocated by the first bidirectional search.
+static unsigned int GetAllocCount(const dtNavMeshQuery *navQuery) {
+	const dtNodePool *nodePool = navQuery->getNodePool();
+	const dtNodePool *backNodePool = navQuery->getBackNodePool();
+	return (nodePool ? nodePool->getAllocCount() : 0) + (backNodePool ? backNodePool->getAllocCount() : 0);
+}
+
+static unsigned int GetPushCount(const dtNavMeshQuery *navQuery) {
+	const dtNodeQueue *openList = navQuery->getOpenList();
+	const dtNodeQueue *backOpenList = navQuery->getBackOpenList();
+	return (openList ? openList->getPushCount() : 0) + (backOpenList ? backOpenList->getPushCount() : 0);
+}
+
+QueryStatsScope::QueryStatsScope(QueryStats *stats, QueryStatsApi api, const dtNavMeshQuery *navQuery)
+	: m_stats(stats), m_api(api), m_navQuery(navQuery), m_start(0), m_nodes(0), m_pushes(0), m_outOfNodes(0), m_partialResults(0), m_failures(0) {
+	if (!m_stats) {
+		return;
+	}
+	m_nodes = GetAllocCount(m_navQuery);
+	m_pushes = GetPushCount(m_navQuery);
+	m_start = uv_hrtime();
+}
+
+QueryStatsScope::~QueryStatsScope() {
+	if (!m_stats) {
+		return;
+	}
+	const unsigned long long nanos = uv_hrtime() - m_start;
+	const unsigned int nodes = GetAllocCount(m_navQuery) - m_nodes;
+	const unsigned int pushes = GetPushCount(m_navQuery) - m_pushes;
+	m_stats->Record(m_api, nanos, nodes, pushes, m_outOfNodes, m_partialResults, m_failures);
+}
+
+void QueryStatsScope::AddStatus(dtStatus status) {
+	if (dtStatusFailed(status)) {
+		m_failures++;
+	}
+	if (dtStatusDetail(status, DT_OUT_OF_NODES)) {
+		m_outOfNodes++;
+	}
+	if (dtStatusDetail(status, DT_PARTIAL_RESULT)) {
+		m_partialResults++;
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef NAVQUERY_QUERYSTATS_H
+#define NAVQUERY_QUERYSTATS_H
+
+#include <uv.h>
+
+#include "DetourNavMeshQuery.h"
+
+// Query APIs counted separately by QueryStats.
+enum QueryStatsApi {
+	QUERY_STATS_FIND_NEAREST_POLY,
+	QUERY_STATS_FIND_NEAREST_POLY_BATCH,
+	QUERY_STATS_FIND_RANDOM_POINT,
+	QUERY_STATS_FIND_RANDOM_POINTS,
+	QUERY_STATS_FIND_RANDOM_POINT_AROUND_CIRCLE,
+	QUERY_STATS_FIND_STRAIGHT_PATH,
+	QUERY_STATS_FIND_STRAIGHT_PATH_ASYNC,
+	QUERY_STATS_FIND_STRAIGHT_PATH_BATCH,
+	QUERY_STATS_RAYCAST,
+	QUERY_STATS_MOVE_ALONG_SURFACE,
+	QUERY_STATS_FIND_DISTANCE_TO_WALL,
+	QUERY_STATS_FIND_POLYS_AROUND_CIRCLE,
+	QUERY_STATS_FIND_LOCAL_NEIGHBOURHOOD,
+	QUERY_STATS_API_COUNT
+};
+
+// Bucket 0 counts calls under 1 microsecond, bucket i > 0 calls of
+// 2^(i-1) up to 2^i microseconds and the last one everything slower.
+static const int QUERY_STATS_BUCKETS = 20;
+
+struct QueryStatsEntry {
+	unsigned long long count;
+	// Nodes taken from the dtNodePool and pushes onto the open list.
+	unsigned long long nodes;
+	unsigned long long pushes;
+	// Searches that reported DT_OUT_OF_NODES or DT_PARTIAL_RESULT, or failed.
+	unsigned long long outOfNodes;
+	unsigned long long partialResults;
+	unsigned long long failures;
+	unsigned long long totalNanos;
+	unsigned long long maxNanos;
+	unsigned int histogram[QUERY_STATS_BUCKETS];
+};
+
+// Cumulative per-API counters of one NavQuery. Safe to use from several
+// threads, threadpool workers record into it too.
+class QueryStats {
+public:
+	QueryStats();
+	~QueryStats();
+
+	void Record(QueryStatsApi api, unsigned long long nanos, unsigned int nodes, unsigned int pushes,
+		unsigned int outOfNodes, unsigned int partialResults, unsigned int failures);
+
+	// Copies QUERY_STATS_API_COUNT entries into entries.
+	void Snapshot(QueryStatsEntry *entries);
+	void Reset();
+
+	static const char *GetApiName(QueryStatsApi api);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	QueryStats(const QueryStats&);
+	QueryStats& operator=(const QueryStats&);
+
+	QueryStatsEntry m_entries[QUERY_STATS_API_COUNT];
+	uv_mutex_t m_mutex;
+};
+
+// Measures one query call. Node and push counts are the growth of the
+// monotonic Detour counters of navQuery over the scope, so they include
+// every search run on it in between. Does nothing when stats is NULL.
+class QueryStatsScope {
+public:
+	QueryStatsScope(QueryStats *stats, QueryStatsApi api, const dtNavMeshQuery *navQuery);
+	~QueryStatsScope();
+
+	// Counts the detail bits of the status of one search.
+	void AddStatus(dtStatus status);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	QueryStatsScope(const QueryStatsScope&);
+	QueryStatsScope& operator=(const QueryStatsScope&);
+
+	QueryStats *m_stats;
+	QueryStatsApi m_api;
+	const dtNavMeshQuery *m_navQuery;
+	unsigned long long m_start;
+	unsigned int m_nodes;
+	unsigned int m_pushes;
+	unsigned int m_outOfNodes;
+	unsigned int m_partialResults;
+	unsigned int m_failures;
+};
+
+#endif // NAVQUERY_QUERYSTATS_H
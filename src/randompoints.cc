@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "DetourCommon.h"
+#include "randompoints.h"
+
+RandomGenerator::RandomGenerator(unsigned long long seed) {
+	Seed(seed);
+}
+
+void RandomGenerator::Seed(unsigned long long seed) {
+	m_state = 0;
+	Next();
+	m_state += seed;
+	Next();
+}
+
+unsigned int RandomGenerator::Next() {
+	unsigned long long state = m_state;
+	m_state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	unsigned int xorShifted = (unsigned int)(((state >> 18) ^ state) >> 27);
+	unsigned int rot = (unsigned int)(state >> 59);
+	return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+}
+
+float RandomGenerator::NextFloat() {
+	// 24 bits fit a float mantissa exactly, so the result never rounds to 1.
+	return (float)(Next() >> 8) * (1.0f / 16777216.0f);
+}
+
+RandomPointTable::RandomPointTable() : m_navMesh(NULL), m_version(0), m_filterHash(0) {
+}
+
+void RandomPointTable::Reset() {
+	m_navMesh = NULL;
+	m_refs.clear();
+	m_areas.clear();
+}
+
+void RandomPointTable::Update(const dtNavMesh *navMesh, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash) {
+	if (navMesh == m_navMesh && version == m_version && filterHash == m_filterHash) {
+		return;
+	}
+	m_navMesh = navMesh;
+	m_version = version;
+	m_filterHash = filterHash;
+	m_refs.clear();
+	m_areas.clear();
+	double areaSum = 0.0;
+	for (int tileIndex = 0; tileIndex < navMesh->getMaxTiles(); tileIndex++) {
+		const dtMeshTile *tile = navMesh->getTile(tileIndex);
+		if (!tile || !tile->header) {
+			continue;
+		}
+		const dtPolyRef base = navMesh->getPolyRefBase(tile);
+		for (int polyIndex = 0; polyIndex < tile->header->polyCount; polyIndex++) {
+			const dtPoly *poly = &tile->polys[polyIndex];
+			// Off-mesh connections are never returned.
+			if (poly->getType() != DT_POLYTYPE_GROUND) {
+				continue;
+			}
+			// dtQueryFilter::passFilter is only defined inside Detour.
+			if ((poly->flags & filter->getIncludeFlags()) == 0 || (poly->flags & filter->getExcludeFlags()) != 0) {
+				continue;
+			}
+			const dtPolyRef ref = base | (dtPolyRef)polyIndex;
+			float polyArea = 0.0f;
+			for (int vertIndex = 2; vertIndex < poly->vertCount; vertIndex++) {
+				const float *va = &tile->verts[poly->verts[0] * 3];
+				const float *vb = &tile->verts[poly->verts[vertIndex - 1] * 3];
+				const float *vc = &tile->verts[poly->verts[vertIndex] * 3];
+				polyArea += dtTriArea2D(va, vb, vc);
+			}
+			if (polyArea <= 0.0f) {
+				continue;
+			}
+			areaSum += polyArea;
+			m_refs.push_back(ref);
+			m_areas.push_back(areaSum);
+		}
+	}
+}
+
+dtStatus RandomPointTable::Sample(const dtNavMeshQuery *navQuery, RandomGenerator &generator, dtPolyRef *randomRef, float *randomPt) const {
+	if (m_areas.empty()) {
+		return DT_FAILURE;
+	}
+	const double u = generator.NextFloat() * m_areas.back();
+	size_t index = std::upper_bound(m_areas.begin(), m_areas.end(), u) - m_areas.begin();
+	if (index >= m_refs.size()) {
+		index = m_refs.size() - 1;
+	}
+	const dtPolyRef polyRef = m_refs[index];
+	const dtMeshTile *tile = NULL;
+	const dtPoly *poly = NULL;
+	m_navMesh->getTileAndPolyByRefUnsafe(polyRef, &tile, &poly);
+
+	float verts[3 * DT_VERTS_PER_POLYGON];
+	float areas[DT_VERTS_PER_POLYGON];
+	for (int vertIndex = 0; vertIndex < poly->vertCount; vertIndex++) {
+		dtVcopy(&verts[vertIndex * 3], &tile->verts[poly->verts[vertIndex] * 3]);
+	}
+	const float s = generator.NextFloat();
+	const float t = generator.NextFloat();
+	float pt[3];
+	dtRandomPointInConvexPoly(verts, poly->vertCount, areas, s, t, pt);
+
+	float h = 0.0f;
+	dtStatus status = navQuery->getPolyHeight(polyRef, pt, &h);
+	if (dtStatusFailed(status)) {
+		return status;
+	}
+	pt[1] = h;
+	dtVcopy(randomPt, pt);
+	*randomRef = polyRef;
+	return DT_SUCCESS;
+}
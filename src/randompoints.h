@@ -0,0 +1,50 @@
+#ifndef NAVQUERY_RANDOMPOINTS_H
+#define NAVQUERY_RANDOMPOINTS_H
+
+#include <vector>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+// PCG32 generator. Each NavQuery owns one, so a seed reproduces the same
+// points regardless of other queries and threads.
+class RandomGenerator {
+public:
+	explicit RandomGenerator(unsigned long long seed);
+
+	void Seed(unsigned long long seed);
+	unsigned int Next();
+	// Uniform in [0, 1).
+	float NextFloat();
+
+private:
+	unsigned long long m_state;
+};
+
+// Cumulative area table over the ground polys of a navmesh that pass a
+// filter. Built once in O(tiles + polys), after which each point is drawn
+// with a binary search, with the same area weighting as
+// dtNavMeshQuery::findRandomPoint.
+class RandomPointTable {
+public:
+	RandomPointTable();
+
+	// Forgets the table, e.g. when another mesh is attached.
+	void Reset();
+
+	// Rebuilds the table unless it was built for the same mesh, flags
+	// version and filter hash.
+	void Update(const dtNavMesh *navMesh, unsigned int version, const dtQueryFilter *filter, unsigned int filterHash);
+
+	// Draws a point. Fails when no poly passes the filter.
+	dtStatus Sample(const dtNavMeshQuery *navQuery, RandomGenerator &generator, dtPolyRef *randomRef, float *randomPt) const;
+
+private:
+	const dtNavMesh *m_navMesh;
+	unsigned int m_version;
+	unsigned int m_filterHash;
+	std::vector<dtPolyRef> m_refs;
+	std::vector<double> m_areas;
+};
+
+#endif // NAVQUERY_RANDOMPOINTS_H
@@ -0,0 +1,503 @@
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "fastlz.h"
+#include "tileset.h"
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+static unsigned int crcTable[256];
+
+static void InitCrcTable() {
+	for (unsigned int index = 0; index < 256; index++) {
+		unsigned int crc = index;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 1) ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+		}
+		crcTable[index] = crc;
+	}
+}
+
+static unsigned int Crc32(const unsigned char *data, size_t size) {
+	static uv_once_t once = UV_ONCE_INIT;
+	uv_once(&once, InitCrcTable);
+	unsigned int crc = 0xffffffffu;
+	for (size_t index = 0; index < size; index++) {
+		crc = crcTable[(crc ^ data[index]) & 0xff] ^ (crc >> 8);
+	}
+	return crc ^ 0xffffffffu;
+}
+
+static bool CompareEntries(const TileSetEntry &a, const TileSetEntry &b) {
+	if (a.y != b.y) return a.y < b.y;
+	if (a.x != b.x) return a.x < b.x;
+	return a.layer < b.layer;
+}
+
+TileSet::TileSet() : m_fp(NULL), m_data(NULL), m_dataSize(0), m_fileSize(0) {
+	memset(&m_header, 0, sizeof(m_header));
+	uv_mutex_init(&m_mutex);
+}
+
+TileSet::~TileSet() {
+	if (m_fp) {
+		fclose(m_fp);
+		m_fp = NULL;
+	}
+	uv_mutex_destroy(&m_mutex);
+}
+
+bool TileSet::ReadBytes(unsigned long long offset, void *buffer, size_t size) {
+	if (offset > m_fileSize || size > m_fileSize - offset) {
+		return false;
+	}
+	if (m_data) {
+		memcpy(buffer, m_data + offset, size);
+		return true;
+	}
+	uv_mutex_lock(&m_mutex);
+	bool result = fseek64(m_fp, offset, SEEK_SET) == 0 && fread(buffer, size, 1, m_fp) == 1;
+	uv_mutex_unlock(&m_mutex);
+	return result;
+}
+
+bool TileSet::ReadDirectory(char *error, size_t errorSize) {
+	if (!ReadBytes(0, &m_header, sizeof(TileSetHeader))) {
+		snprintf(error, errorSize, "Truncated tile set");
+		return false;
+	}
+	if (m_header.magic != TILESET_MAGIC) {
+		snprintf(error, errorSize, "Not a tile set");
+		return false;
+	}
+	if (m_header.version != TILESET_VERSION) {
+		snprintf(error, errorSize, "Unsupported tile set version %d", m_header.version);
+		return false;
+	}
+	if (m_header.numTiles < 0 || (unsigned long long)m_header.numTiles * sizeof(TileSetEntry) > m_fileSize) {
+		snprintf(error, errorSize, "Truncated tile set");
+		return false;
+	}
+	m_entries.resize(m_header.numTiles);
+	if (m_header.numTiles > 0 && !ReadBytes(sizeof(TileSetHeader), &m_entries[0], m_entries.size() * sizeof(TileSetEntry))) {
+		snprintf(error, errorSize, "Truncated tile set");
+		return false;
+	}
+	for (size_t index = 0; index < m_entries.size(); index++) {
+		const TileSetEntry &entry = m_entries[index];
+		if (entry.offset > m_fileSize || entry.storedSize > m_fileSize - entry.offset) {
+			snprintf(error, errorSize, "Truncated tile set");
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TileSet::Open(const char *path, char *error, size_t errorSize) {
+	m_fp = fopen(path, "rb");
+	if (!m_fp) {
+		snprintf(error, errorSize, "No such file or directory");
+		return false;
+	}
+	if (fseek64(m_fp, 0, SEEK_END) != 0) {
+		snprintf(error, errorSize, "fseek");
+		return false;
+	}
+	m_fileSize = (unsigned long long)ftell64(m_fp);
+	return ReadDirectory(error, errorSize);
+}
+
+bool TileSet::Open(unsigned char *data, size_t dataSize, char *error, size_t errorSize) {
+	m_data = data;
+	m_dataSize = dataSize;
+	m_fileSize = dataSize;
+	return ReadDirectory(error, errorSize);
+}
+
+int TileSet::FindTile(int x, int y, int layer) const {
+	TileSetEntry key;
+	key.x = x;
+	key.y = y;
+	key.layer = layer;
+	std::vector<TileSetEntry>::const_iterator it = std::lower_bound(m_entries.begin(), m_entries.end(), key, CompareEntries);
+	if (it == m_entries.end() || it->x != x || it->y != y || it->layer != layer) {
+		return -1;
+	}
+	return (int)(it - m_entries.begin());
+}
+
+int TileSet::FindFirstTile(int x, int y) const {
+	TileSetEntry key;
+	key.x = x;
+	key.y = y;
+	key.layer = INT_MIN;
+	std::vector<TileSetEntry>::const_iterator it = std::lower_bound(m_entries.begin(), m_entries.end(), key, CompareEntries);
+	if (it == m_entries.end() || it->x != x || it->y != y) {
+		return -1;
+	}
+	return (int)(it - m_entries.begin());
+}
+
+unsigned char *TileSet::ReadTile(int index, char *error, size_t errorSize) {
+	const TileSetEntry &entry = m_entries[index];
+	const bool compressed = entry.compression != TILESET_COMPRESSION_NONE;
+	unsigned char *stored = (unsigned char*)dtAlloc(entry.storedSize, compressed ? DT_ALLOC_TEMP : DT_ALLOC_PERM);
+	if (!stored) {
+		snprintf(error, errorSize, "Out of Memory");
+		return NULL;
+	}
+	if (!ReadBytes(entry.offset, stored, entry.storedSize)) {
+		dtFree(stored);
+		snprintf(error, errorSize, "Truncated tile set");
+		return NULL;
+	}
+	if (Crc32(stored, entry.storedSize) != entry.checksum) {
+		dtFree(stored);
+		snprintf(error, errorSize, "Checksum mismatch in tile %d,%d,%d", entry.x, entry.y, entry.layer);
+		return NULL;
+	}
+	if (!compressed) {
+		return stored;
+	}
+	unsigned char *data = (unsigned char*)dtAlloc(entry.dataSize, DT_ALLOC_PERM);
+	if (!data) {
+		dtFree(stored);
+		snprintf(error, errorSize, "Out of Memory");
+		return NULL;
+	}
+	int dataSize = fastlz_decompress(stored, (int)entry.storedSize, data, (int)entry.dataSize);
+	dtFree(stored);
+	if (dataSize != (int)entry.dataSize) {
+		dtFree(data);
+		snprintf(error, errorSize, "Corrupted tile %d,%d,%d", entry.x, entry.y, entry.layer);
+		return NULL;
+	}
+	return data;
+}
+
+unsigned char *TileSet::GetTileInPlace(int index, char *error, size_t errorSize) {
+	const TileSetEntry &entry = m_entries[index];
+	if (!m_data || entry.compression != TILESET_COMPRESSION_NONE) {
+		return NULL;
+	}
+	unsigned char *data = m_data + entry.offset;
+	if (Crc32(data, entry.storedSize) != entry.checksum) {
+		snprintf(error, errorSize, "Checksum mismatch in tile %d,%d,%d", entry.x, entry.y, entry.layer);
+		return NULL;
+	}
+	return data;
+}
+
+bool IsTileSet(const unsigned char *data, size_t dataSize) {
+	int magic = 0;
+	if (dataSize < sizeof(TileSetHeader)) {
+		return false;
+	}
+	memcpy(&magic, data, sizeof(magic));
+	return magic == TILESET_MAGIC;
+}
+
+bool IsTileSetFile(const char *path) {
+	int magic = 0;
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		return false;
+	}
+	size_t readLen = fread(&magic, sizeof(magic), 1, fp);
+	fclose(fp);
+	return readLen == 1 && magic == TILESET_MAGIC;
+}
+
+dtNavMesh *CreateNavMeshFromTileSet(TileSet &tileSet, bool inPlace, char *error, size_t errorSize) {
+	dtNavMesh *navMesh = dtAllocNavMesh();
+	if (!navMesh) {
+		snprintf(error, errorSize, "dtAllocNavMesh");
+		return NULL;
+	}
+	dtStatus status = navMesh->init(tileSet.GetParams());
+	if (dtStatusFailed(status)) {
+		dtFreeNavMesh(navMesh);
+		snprintf(error, errorSize, "dtNavMesh->init 0x%x", status);
+		return NULL;
+	}
+	for (int index = 0; index < tileSet.GetTileCount(); index++) {
+		const TileSetEntry &entry = tileSet.GetEntry(index);
+		error[0] = '\0';
+		unsigned char *data = inPlace ? tileSet.GetTileInPlace(index, error, errorSize) : NULL;
+		int flags = 0;
+		if (!data) {
+			if (error[0] != '\0') {
+				dtFreeNavMesh(navMesh);
+				return NULL;
+			}
+			data = tileSet.ReadTile(index, error, errorSize);
+			if (!data) {
+				dtFreeNavMesh(navMesh);
+				return NULL;
+			}
+			flags = DT_TILE_FREE_DATA;
+		}
+		status = navMesh->addTile(data, (int)entry.dataSize, flags, (dtTileRef)entry.tileRef, 0);
+		if (dtStatusFailed(status) && flags == DT_TILE_FREE_DATA) {
+			dtFree(data);
+		}
+	}
+	return navMesh;
+}
+
+bool SaveTileSet(const dtNavMesh *navMesh, const char *path, int compressionLevel, char *error, size_t errorSize) {
+	std::vector<TileSetEntry> entries;
+	std::vector<const dtMeshTile*> tiles;
+	for (int index = 0; index < navMesh->getMaxTiles(); index++) {
+		const dtMeshTile *tile = navMesh->getTile(index);
+		if (!tile || !tile->header || !tile->dataSize) continue;
+		TileSetEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.x = tile->header->x;
+		entry.y = tile->header->y;
+		entry.layer = tile->header->layer;
+		entry.tileRef = navMesh->getTileRef(tile);
+		entry.dataSize = (unsigned int)tile->dataSize;
+		// Directory order is fixed below, reserved temporarily holds the tile.
+		entry.reserved = (unsigned int)tiles.size();
+		tiles.push_back(tile);
+		entries.push_back(entry);
+	}
+	std::sort(entries.begin(), entries.end(), CompareEntries);
+
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		snprintf(error, errorSize, "Cannot open %s for writing", path);
+		return false;
+	}
+	TileSetHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = TILESET_MAGIC;
+	header.version = TILESET_VERSION;
+	header.numTiles = (int)entries.size();
+	memcpy(&header.params, navMesh->getParams(), sizeof(dtNavMeshParams));
+
+	// Payloads are written first, the directory is filled in afterwards.
+	unsigned long long offset = sizeof(TileSetHeader) + entries.size() * sizeof(TileSetEntry);
+	std::vector<unsigned char> compressed;
+	static const unsigned char padding[TILESET_ALIGNMENT] = { 0 };
+	bool result = fseek64(fp, 0, SEEK_SET) == 0;
+	for (size_t index = 0; result && index < entries.size(); index++) {
+		TileSetEntry &entry = entries[index];
+		const dtMeshTile *tile = tiles[entry.reserved];
+		entry.reserved = 0;
+		unsigned long long aligned = (offset + TILESET_ALIGNMENT - 1) & ~(unsigned long long)(TILESET_ALIGNMENT - 1);
+		const unsigned char *stored = tile->data;
+		entry.compression = TILESET_COMPRESSION_NONE;
+		entry.storedSize = entry.dataSize;
+		if (compressionLevel > 0 && tile->dataSize >= 16) {
+			compressed.resize(dtMax(66, (int)(tile->dataSize * 1.05f) + 1));
+			int compressedSize = fastlz_compress_level(compressionLevel > 1 ? 2 : 1, tile->data, tile->dataSize, &compressed[0]);
+			if (compressedSize > 0 && compressedSize < tile->dataSize) {
+				stored = &compressed[0];
+				entry.compression = TILESET_COMPRESSION_FASTLZ;
+				entry.storedSize = (unsigned int)compressedSize;
+			}
+		}
+		entry.offset = aligned;
+		entry.checksum = Crc32(stored, entry.storedSize);
+		result = fseek64(fp, offset, SEEK_SET) == 0
+			&& (aligned == offset || fwrite(padding, (size_t)(aligned - offset), 1, fp) == 1)
+			&& fwrite(stored, entry.storedSize, 1, fp) == 1;
+		offset = aligned + entry.storedSize;
+	}
+	result = result
+		&& fseek64(fp, 0, SEEK_SET) == 0
+		&& fwrite(&header, sizeof(TileSetHeader), 1, fp) == 1
+		&& (entries.empty() || fwrite(&entries[0], entries.size() * sizeof(TileSetEntry), 1, fp) == 1);
+	if (fclose(fp) != 0) {
+		result = false;
+	}
+	if (!result) {
+		snprintf(error, errorSize, "Cannot write %s", path);
+	}
+	return result;
+}
+
+TileStreamer::TileStreamer(size_t budget, int margin) : m_navMesh(NULL), m_budget(budget), m_margin(margin), m_minX(0), m_minY(0), m_maxX(-1), m_maxY(-1), m_clock(0) {
+	memset(&m_stats, 0, sizeof(m_stats));
+	uv_mutex_init(&m_mutex);
+	uv_rwlock_init(&m_lock);
+}
+
+TileStreamer::~TileStreamer() {
+	uv_rwlock_destroy(&m_lock);
+	uv_mutex_destroy(&m_mutex);
+}
+
+bool TileStreamer::Open(const char *path, dtNavMesh *navMesh, char *error, size_t errorSize) {
+	if (!m_tileSet.Open(path, error, errorSize)) {
+		return false;
+	}
+	dtStatus status = navMesh->init(m_tileSet.GetParams());
+	if (dtStatusFailed(status)) {
+		snprintf(error, errorSize, "dtNavMesh->init 0x%x", status);
+		return false;
+	}
+	m_navMesh = navMesh;
+	m_lruPos.resize(m_tileSet.GetTileCount(), m_lru.end());
+	m_refs.resize(m_tileSet.GetTileCount(), 0);
+	m_stamps.resize(m_tileSet.GetTileCount(), 0);
+	for (int index = 0; index < m_tileSet.GetTileCount(); index++) {
+		const TileSetEntry &entry = m_tileSet.GetEntry(index);
+		if (index == 0 || entry.x < m_minX) m_minX = entry.x;
+		if (index == 0 || entry.y < m_minY) m_minY = entry.y;
+		if (index == 0 || entry.x > m_maxX) m_maxX = entry.x;
+		if (index == 0 || entry.y > m_maxY) m_maxY = entry.y;
+	}
+	return true;
+}
+
+float TileStreamer::MinDetour(const float *bmin, const float *bmax, int padding, const float *startPos, const float *endPos) const {
+	int minX, minY, maxX, maxY;
+	m_navMesh->calcTileLoc(bmin, &minX, &minY);
+	m_navMesh->calcTileLoc(bmax, &maxX, &maxY);
+	minX -= padding;
+	minY -= padding;
+	maxX += padding;
+	maxY += padding;
+
+	// The shortest way through a side of the region touches it where the
+	// straight line to endPos mirrored at that side crosses it.
+	const dtNavMeshParams *params = m_navMesh->getParams();
+	const float dx = startPos[0] - endPos[0];
+	const float dz = startPos[2] - endPos[2];
+	float detour = FLT_MAX;
+	if (minX > m_minX) {
+		const float side = params->orig[0] + minX * params->tileWidth;
+		detour = dtMin(detour, sqrtf(dtSqr(startPos[0] + endPos[0] - 2 * side) + dz * dz));
+	}
+	if (maxX < m_maxX) {
+		const float side = params->orig[0] + (maxX + 1) * params->tileWidth;
+		detour = dtMin(detour, sqrtf(dtSqr(2 * side - startPos[0] - endPos[0]) + dz * dz));
+	}
+	if (minY > m_minY) {
+		const float side = params->orig[2] + minY * params->tileHeight;
+		detour = dtMin(detour, sqrtf(dtSqr(startPos[2] + endPos[2] - 2 * side) + dx * dx));
+	}
+	if (maxY < m_maxY) {
+		const float side = params->orig[2] + (maxY + 1) * params->tileHeight;
+		detour = dtMin(detour, sqrtf(dtSqr(2 * side - startPos[2] - endPos[2]) + dx * dx));
+	}
+	return detour;
+}
+
+void TileStreamer::Touch(int index) {
+	if (m_lruPos[index] != m_lru.end()) {
+		m_lru.erase(m_lruPos[index]);
+	}
+	m_lru.push_front(index);
+	m_lruPos[index] = m_lru.begin();
+	m_stamps[index] = ++m_clock;
+}
+
+void TileStreamer::EnsureResident(const float *bmin, const float *bmax, int padding) {
+	int minX, minY, maxX, maxY;
+	m_navMesh->calcTileLoc(bmin, &minX, &minY);
+	m_navMesh->calcTileLoc(bmax, &maxX, &maxY);
+	minX -= padding;
+	minY -= padding;
+	maxX += padding;
+	maxY += padding;
+
+	uv_mutex_lock(&m_mutex);
+	const unsigned long long stamp = m_clock;
+	std::vector<int> missing;
+	const int tileCount = m_tileSet.GetTileCount();
+	const long long columns = (long long)(maxX - minX + 1) * (maxY - minY + 1);
+	if (columns > tileCount) {
+		// Huge regions are cheaper to match against the whole directory.
+		for (int index = 0; index < tileCount; index++) {
+			const TileSetEntry &entry = m_tileSet.GetEntry(index);
+			if (entry.x >= minX && entry.x <= maxX && entry.y >= minY && entry.y <= maxY) {
+				if (!m_refs[index]) missing.push_back(index);
+				Touch(index);
+			}
+		}
+	} else {
+		for (int y = minY; y <= maxY; y++) {
+			for (int x = minX; x <= maxX; x++) {
+				for (int index = m_tileSet.FindFirstTile(x, y); index >= 0 && index < tileCount; index++) {
+					const TileSetEntry &entry = m_tileSet.GetEntry(index);
+					if (entry.x != x || entry.y != y) break;
+					if (!m_refs[index]) missing.push_back(index);
+					Touch(index);
+				}
+			}
+		}
+	}
+	if (missing.empty() && m_stats.residentBytes <= m_budget) {
+		uv_mutex_unlock(&m_mutex);
+		return;
+	}
+
+	// Tiles are read and inflated before queries are locked out.
+	char error[256];
+	std::vector<unsigned char*> data(missing.size(), NULL);
+	for (size_t index = 0; index < missing.size(); index++) {
+		data[index] = m_tileSet.ReadTile(missing[index], error, sizeof(error));
+	}
+
+	uv_rwlock_wrlock(&m_lock);
+	for (size_t index = 0; index < missing.size(); index++) {
+		const int tileIndex = missing[index];
+		const TileSetEntry &entry = m_tileSet.GetEntry(tileIndex);
+		dtTileRef ref = 0;
+		dtStatus status = DT_FAILURE;
+		if (data[index]) {
+			status = m_navMesh->addTile(data[index], (int)entry.dataSize, DT_TILE_FREE_DATA, (dtTileRef)entry.tileRef, &ref);
+			if (dtStatusFailed(status)) {
+				dtFree(data[index]);
+			}
+		}
+		if (dtStatusFailed(status)) {
+			// Dropped from the LRU so the next query retries it.
+			m_lru.erase(m_lruPos[tileIndex]);
+			m_lruPos[tileIndex] = m_lru.end();
+			m_stats.failures++;
+			continue;
+		}
+		m_refs[tileIndex] = ref;
+		m_stats.residentTiles++;
+		m_stats.residentBytes += entry.dataSize;
+		m_stats.loads++;
+	}
+	while (m_stats.residentBytes > m_budget && !m_lru.empty()) {
+		const int tileIndex = m_lru.back();
+		if (m_stamps[tileIndex] > stamp) {
+			break;
+		}
+		m_lru.pop_back();
+		m_lruPos[tileIndex] = m_lru.end();
+		m_navMesh->removeTile(m_refs[tileIndex], NULL, NULL);
+		m_refs[tileIndex] = 0;
+		m_stats.residentTiles--;
+		m_stats.residentBytes -= m_tileSet.GetEntry(tileIndex).dataSize;
+		m_stats.evictions++;
+	}
+	uv_rwlock_wrunlock(&m_lock);
+	uv_mutex_unlock(&m_mutex);
+}
+
+TileStreamerStats TileStreamer::GetStats() {
+	uv_mutex_lock(&m_mutex);
+	TileStreamerStats stats = m_stats;
+	uv_mutex_unlock(&m_mutex);
+	return stats;
+}
@@ -0,0 +1,177 @@
+#ifndef NAVQUERY_TILESET_H
+#define NAVQUERY_TILESET_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <uv.h>
+#include <list>
+#include <vector>
+
+#include "DetourNavMesh.h"
+
+// Indexed tile set container. Unlike the sequential MSET stream it starts
+// with a directory, so single tiles can be located and read directly:
+//
+//   TileSetHeader
+//   TileSetEntry[numTiles]    sorted by (y, x, layer)
+//   tile payloads             each aligned to TILESET_ALIGNMENT bytes
+//
+// A payload is raw Detour tile data or a fastlz block, and checksum is the
+// CRC-32 of the payload as stored. All values are little endian.
+static const int TILESET_MAGIC = 'N'<<24 | 'T'<<16 | 'I'<<8 | 'X'; //'NTIX';
+static const int TILESET_VERSION = 1;
+static const int TILESET_ALIGNMENT = 16;
+
+enum TileSetCompression {
+	TILESET_COMPRESSION_NONE = 0,
+	TILESET_COMPRESSION_FASTLZ = 1,
+};
+
+struct TileSetHeader {
+	int magic;
+	int version;
+	int numTiles;
+	int reserved;
+	dtNavMeshParams params;
+};
+
+struct TileSetEntry {
+	int x;
+	int y;
+	int layer;
+	unsigned int compression;
+	unsigned long long tileRef;
+	unsigned long long offset;
+	unsigned int storedSize;
+	unsigned int dataSize;
+	unsigned int checksum;
+	unsigned int reserved;
+};
+
+// Read access to a tile set in a file or in memory. Only the header and the
+// directory are read up front.
+class TileSet {
+public:
+	TileSet();
+	~TileSet();
+
+	// Reads the header and directory. The file stays open for ReadTile.
+	bool Open(const char *path, char *error, size_t errorSize);
+	// Uses a tile set image in memory, which must outlive this object.
+	bool Open(unsigned char *data, size_t dataSize, char *error, size_t errorSize);
+
+	inline const dtNavMeshParams *GetParams() const { return &m_header.params; }
+	inline int GetTileCount() const { return (int)m_entries.size(); }
+	inline const TileSetEntry &GetEntry(int index) const { return m_entries[index]; }
+
+	// Returns the directory index of the tile at x, y, layer or -1.
+	int FindTile(int x, int y, int layer) const;
+	// Returns the directory index of the first layer at x, y or -1. Further
+	// layers of the column follow it in the directory.
+	int FindFirstTile(int x, int y) const;
+
+	// Returns the verified and decompressed tile in dtAlloc memory, to be
+	// added with DT_TILE_FREE_DATA. Safe to call from several threads.
+	unsigned char *ReadTile(int index, char *error, size_t errorSize);
+
+	// For an in-memory tile set, returns the verified uncompressed payload
+	// of a tile in place, or NULL when it is compressed.
+	unsigned char *GetTileInPlace(int index, char *error, size_t errorSize);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	TileSet(const TileSet&);
+	TileSet& operator=(const TileSet&);
+
+	bool ReadDirectory(char *error, size_t errorSize);
+	bool ReadBytes(unsigned long long offset, void *buffer, size_t size);
+
+	TileSetHeader m_header;
+	std::vector<TileSetEntry> m_entries;
+	FILE *m_fp;
+	unsigned char *m_data;
+	size_t m_dataSize;
+	unsigned long long m_fileSize;
+	uv_mutex_t m_mutex;
+};
+
+bool IsTileSet(const unsigned char *data, size_t dataSize);
+bool IsTileSetFile(const char *path);
+
+// Adds every tile of a tile set to a new dtNavMesh. With inPlace set,
+// uncompressed tiles of an in-memory tile set are used without copying.
+dtNavMesh *CreateNavMeshFromTileSet(TileSet &tileSet, bool inPlace, char *error, size_t errorSize);
+
+// Writes all tiles of navMesh as a tile set. compressionLevel 0 stores tiles
+// raw, 1 and 2 select the fastlz level; tiles that do not shrink stay raw.
+bool SaveTileSet(const dtNavMesh *navMesh, const char *path, int compressionLevel, char *error, size_t errorSize);
+
+struct TileStreamerStats {
+	int residentTiles;
+	size_t residentBytes;
+	unsigned long long loads;
+	unsigned long long evictions;
+	unsigned long long failures;
+};
+
+// Keeps only the tiles of a tile set file that queries touch in a dtNavMesh.
+// Tiles are added when a query first needs them and the least recently used
+// ones are removed once their data exceeds the budget. Tiles come back with
+// their original tile ref, so poly refs stay valid across eviction.
+//
+// Queries call EnsureResident for the region they will search, then hold
+// LockShared while they run. Tiles are only added and removed under the
+// exclusive lock, so queries on other threads never see a tile go away.
+class TileStreamer {
+public:
+	TileStreamer(size_t budget, int margin);
+	~TileStreamer();
+
+	// Opens the tile set and initialises navMesh with its parameters. No tile
+	// is loaded yet.
+	bool Open(const char *path, dtNavMesh *navMesh, char *error, size_t errorSize);
+
+	// Loads the tiles overlapping bmin..bmax grown by padding tiles, and
+	// evicts others while over budget. Tiles used by this call are never
+	// evicted by it, so one large query may exceed the budget.
+	void EnsureResident(const float *bmin, const float *bmax, int padding);
+
+	// Padding in tiles around the end points of path searches.
+	inline int GetMargin() const { return m_margin; }
+
+	// Length of the shortest way from startPos to endPos, on the xz plane,
+	// that leaves the tiles overlapping bmin..bmax grown by padding tiles.
+	// FLT_MAX when those hold every tile of the set.
+	float MinDetour(const float *bmin, const float *bmax, int padding, const float *startPos, const float *endPos) const;
+
+	inline void LockShared() { uv_rwlock_rdlock(&m_lock); }
+	inline void UnlockShared() { uv_rwlock_rdunlock(&m_lock); }
+
+	TileStreamerStats GetStats();
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	TileStreamer(const TileStreamer&);
+	TileStreamer& operator=(const TileStreamer&);
+
+	void Touch(int index);
+
+	TileSet m_tileSet;
+	dtNavMesh *m_navMesh;
+	size_t m_budget;
+	int m_margin;
+	// Tile coordinates spanned by the tile set.
+	int m_minX, m_minY, m_maxX, m_maxY;
+
+	// Bookkeeping below is guarded by m_mutex, m_lock guards the dtNavMesh.
+	uv_mutex_t m_mutex;
+	uv_rwlock_t m_lock;
+	std::list<int> m_lru;
+	std::vector<std::list<int>::iterator> m_lruPos;
+	std::vector<dtTileRef> m_refs;
+	std::vector<unsigned long long> m_stamps;
+	unsigned long long m_clock;
+	TileStreamerStats m_stats;
+};
+
+#endif // NAVQUERY_TILESET_H
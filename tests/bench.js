@@ -0,0 +1,58 @@
+const recast = require( '../' );
+
+// Times findStraightPath between the same random point pairs for each open
+// list, with and without landmarks: wall time of the best round, and the
+// native time and nodes per search from getStats.
+// node tests/bench.js [navmesh] [pairs]
+const file = process.argv[ 2 ] || __dirname + '/tutorial.bin';
+const pairs = parseInt( process.argv[ 3 ] || '5000', 10 );
+const rounds = 5;
+
+const points = new recast.NavQuery( { seed: 1 } );
+points.load( file );
+const ends = [];
+for ( let i = 0; i < pairs; i++ ) {
+	ends.push( [ points.findRandomPoint(), points.findRandomPoint() ] );
+}
+
+const cases = [];
+[ 'binary', 'quaternary' ].forEach( ( openList ) => {
+	[ false, true ].forEach( ( landmarks ) => {
+		const navQuery = new recast.NavQuery( { openList, stats: true, maxNodes: 65535 } );
+		navQuery.load( file );
+		if ( landmarks ) {
+			navQuery.buildLandmarks( 8 );
+		}
+		cases.push( { name: openList + ( landmarks ? ' + landmarks' : '' ), navQuery, best: Infinity } );
+	} );
+} );
+
+// Interleaved rounds, the best one counts.
+for ( let round = 0; round < rounds; round++ ) {
+	cases.forEach( ( item ) => {
+		const start = process.hrtime.bigint();
+		ends.forEach( ( [ a, b ] ) => item.navQuery.findStraightPath( a, b ) );
+		item.best = Math.min( item.best, Number( process.hrtime.bigint() - start ) / 1e6 );
+	} );
+}
+
+cases.forEach( ( item ) => {
+	const stats = item.navQuery.getStats().findStraightPath;
+	console.log( item.name.padEnd( 24 ), ( item.best.toFixed( 1 ) + 'ms' ).padStart( 10 ), ( ( stats.totalMicros / stats.count ).toFixed( 1 ) + 'us/search' ).padStart( 14 ), ( Math.round( stats.nodes / stats.count ) + ' nodes/search' ).padStart( 18 ) );
+} );
+
+// Dijkstra over the whole mesh, where the open list grows largest.
+const center = ends[ 0 ][ 0 ];
+const refs = new Uint32Array( 65535 );
+cases.filter( ( item ) => item.name.indexOf( 'landmarks' ) < 0 ).forEach( ( item ) => {
+	let best = Infinity;
+	let count = 0;
+	for ( let round = 0; round < rounds; round++ ) {
+		const start = process.hrtime.bigint();
+		for ( let i = 0; i < 20; i++ ) {
+			count = item.navQuery.findPolysAroundCircle( center, 1e6, refs, 65535 );
+		}
+		best = Math.min( best, Number( process.hrtime.bigint() - start ) / 1e6 / 20 );
+	}
+	console.log( ( item.name + ' circle' ).padEnd( 24 ), ( best.toFixed( 2 ) + 'ms' ).padStart( 10 ), ( count + ' polys' ).padStart( 14 ) );
+} );
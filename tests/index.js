@@ -8,6 +8,18 @@ for ( let index = 0; index < 1; index++ ) {
 	result = sample.load( __dirname + '/tutorial.bin' );
 }
 
+// Length of a findStraightPath result.
+const pathLength = ( path ) => {
+	let length = 0;
+	for ( let index = 1; index < path.length; index++ ) {
+		length += Math.hypot( path[ index ].x - path[ index - 1 ].x, path[ index ].y - path[ index - 1 ].y, path[ index ].z - path[ index - 1 ].z );
+	}
+	return length;
+};
+
+// Straight paths end with a point of ref 0, compare where they end instead.
+const sameEnd = ( a, b ) => Math.hypot( a[ a.length - 1 ].x - b[ b.length - 1 ].x, a[ a.length - 1 ].y - b[ b.length - 1 ].y, a[ a.length - 1 ].z - b[ b.length - 1 ].z ) < 1e-3;
+
 if ( sample.load( __dirname + '/tutorial.bin' ) ) {
 	let start = sample.findNearestPoly( 76, 0, 111, 2, 1000, 2 );
 	let end = sample.findNearestPoly( 80, 0, 120, 2, 1000, 2 );
@@ -20,3 +32,511 @@ if ( sample.load( __dirname + '/tutorial.bin' ) ) {
 		console.log( typeof result !== 'object' ? result : JSON.stringify( result.map( data => [ ~~data.x, ~~data.z ] ) ) );
 	}
 }
+
+if ( result ) {
+	let end = sample.findRandomPoint();
+	let pending = [];
+	console.time( 'findStraightPathAsync' );
+	for ( let index = 0; index < 10; index++ ) {
+		pending.push( sample.findStraightPathAsync( sample.findRandomPoint(), end ) );
+	}
+	Promise.all( pending ).then( results => {
+		console.timeEnd( 'findStraightPathAsync' );
+		results.forEach( result => console.log( typeof result !== 'object' ? result : JSON.stringify( result.map( data => [ ~~data.x, ~~data.z ] ) ) ) );
+		sample.findStraightPathAsync( sample.findRandomPoint(), end, ( error, result ) => {
+			console.log( error || result.length );
+		} );
+	} );
+}
+
+if ( result ) {
+	const count = 1000;
+	const starts = new Float32Array( count * 3 );
+	const ends = new Float32Array( count * 3 );
+	const refs = new Uint32Array( count * 2 );
+	for ( let index = 0; index < count; index++ ) {
+		const start = sample.findRandomPoint();
+		const end = sample.findRandomPoint();
+		starts.set( [ start.x, start.y, start.z ], index * 3 );
+		ends.set( [ end.x, end.y, end.z ], index * 3 );
+		refs.set( [ start.ref, end.ref ], index * 2 );
+	}
+	console.time( 'findStraightPathBatch' );
+	const batch = sample.findStraightPathBatch( starts, ends, refs );
+	console.timeEnd( 'findStraightPathBatch' );
+	console.log( batch.offsets[ count ], batch.points.length / 3 );
+}
+
+if ( result ) {
+	const points = new Float32Array( 256 * 3 );
+	const refs = new Uint32Array( 256 );
+	const flags = new Uint8Array( 256 );
+	const start = sample.findRandomPoint();
+	const end = sample.findRandomPoint();
+	const count = sample.findStraightPath( start, end, points, refs, flags );
+	if ( count & recast.constants.DT_FAILURE ) {
+		console.log( 'findStraightPath failed', count );
+	} else {
+		console.log( count, flags[ 0 ] === recast.constants.DT_STRAIGHTPATH_START, flags[ count - 1 ] === recast.constants.DT_STRAIGHTPATH_END );
+	}
+}
+
+if ( result ) {
+	const small = new recast.NavQuery( { maxNodes: 256, maxPath: 64 } );
+	if ( small.load( __dirname + '/tutorial.bin', { maxNodes: 512 } ) ) {
+		const path = small.findStraightPath( sample.findRandomPoint(), sample.findRandomPoint() );
+		console.log( typeof path !== 'object' ? path : path.length );
+	}
+}
+
+if ( result ) {
+	const navMesh = new recast.NavMesh();
+	navMesh.load( __dirname + '/tutorial.bin' );
+	const rooms = [];
+	for ( let index = 0; index < 4; index++ ) {
+		const room = new recast.NavQuery();
+		room.attach( navMesh );
+		rooms.push( room );
+	}
+	const start = rooms[ 0 ].findRandomPoint();
+	const end = rooms[ 1 ].findRandomPoint();
+	const pending = rooms[ 2 ].findStraightPathAsync( start, end );
+	rooms[ 2 ].clear();
+	pending.then( path => console.log( 'shared', rooms[ 3 ].findStraightPath( start, end ).length === path.length ) );
+}
+
+if ( result ) {
+	const mapped = new recast.NavQuery();
+	if ( mapped.load( __dirname + '/tutorial.bin', { mmap: true } ) ) {
+		const start = mapped.findRandomPoint();
+		const end = mapped.findRandomPoint();
+		console.log( 'mmap', mapped.findStraightPath( start, end ).length === sample.findStraightPath( start, end ).length );
+	}
+}
+
+if ( result ) {
+	const fromBuffer = new recast.NavQuery();
+	if ( fromBuffer.loadFromBuffer( fs.readFileSync( __dirname + '/tutorial.bin' ), { inPlace: true } ) ) {
+		const start = fromBuffer.findRandomPoint();
+		const end = fromBuffer.findRandomPoint();
+		console.log( 'loadFromBuffer', fromBuffer.findStraightPath( start, end ).length === sample.findStraightPath( start, end ).length );
+	}
+}
+
+if ( result ) {
+	const live = new recast.NavQuery();
+	live.load( __dirname + '/tutorial.bin' );
+	const start = live.findRandomPoint();
+	const end = live.findRandomPoint();
+	const inFlight = live.findStraightPathAsync( start, end );
+	live.loadAsync( __dirname + '/tutorial.bin', { mmap: true } ).then( () => inFlight ).then( path => {
+		console.log( 'loadAsync', live.filename === __dirname + '/tutorial.bin', live.findStraightPath( start, end ).length === path.length );
+	} );
+	new recast.NavMesh().loadAsync( __dirname + '/missing.bin', error => console.log( 'loadAsync', error.message ) );
+}
+
+if ( result ) {
+	const os = require( 'os' );
+	const packed = os.tmpdir() + '/navquery-tileset.bin';
+	recast.convertNavMesh( __dirname + '/tutorial.bin', packed, { compress: true } );
+	const tiles = new recast.NavQuery();
+	if ( tiles.load( packed ) && tiles.loadFromBuffer( fs.readFileSync( packed ) ) ) {
+		const start = tiles.findRandomPoint();
+		const end = tiles.findRandomPoint();
+		console.log( 'convertNavMesh', fs.statSync( packed ).size < fs.statSync( __dirname + '/tutorial.bin' ).size, tiles.findStraightPath( start, end ).length === sample.findStraightPath( start, end ).length );
+	}
+	const raw = os.tmpdir() + '/navquery-tileset-raw.bin';
+	recast.convertNavMesh( packed, raw );
+	console.log( 'convertNavMesh', tiles.load( raw, { mmap: true } ) );
+	fs.unlinkSync( packed );
+	fs.unlinkSync( raw );
+}
+
+if ( result ) {
+	const packed = require( 'os' ).tmpdir() + '/navquery-stream.bin';
+	recast.convertNavMesh( __dirname + '/tutorial.bin', packed );
+	const streamed = new recast.NavQuery();
+	if ( streamed.load( packed, { stream: true, budget: 32 * 1024 } ) ) {
+		// Unseeded pairs, then pairs of a seeded query among which some ends
+		// are only reached by a detour far wider than the initial margin.
+		const detours = new recast.NavQuery( { seed: 7 } );
+		detours.load( __dirname + '/tutorial.bin' );
+		let same = 0;
+		for ( let index = 0; index < 700; index++ ) {
+			const points = index < 200 ? sample : detours;
+			const start = points.findRandomPoint();
+			const end = points.findRandomPoint();
+			same += Math.abs( pathLength( streamed.findStraightPath( start, end ) ) - pathLength( sample.findStraightPath( start, end ) ) ) < 1e-3;
+		}
+		const stats = streamed.getTileStats();
+		console.log( 'stream', same === 700, stats.evictions > 0, stats.residentTiles < stats.loads );
+	}
+	fs.unlinkSync( packed );
+}
+
+if ( result ) {
+	const start = sample.findRandomPoint();
+	const end = sample.findRandomPoint();
+	const hit = new Float32Array( 7 );
+	const visited = new Uint32Array( 64 );
+	const visitedCount = sample.raycast( start, end, hit, visited, recast.constants.DT_RAYCAST_USE_COSTS );
+	const position = new Float32Array( 3 );
+	const movedCount = sample.moveAlongSurface( start, end, position, visited );
+	const distance = sample.findDistanceToWall( start, 100, hit );
+	console.log( 'raycast', visitedCount > 0 && visited[ 0 ] === start.ref, movedCount > 0, distance === hit[ 0 ] && distance >= 0 );
+}
+
+if ( result ) {
+	const count = 100;
+	const positions = new Float32Array( count * 3 );
+	for ( let index = 0; index < count; index++ ) {
+		const point = sample.findRandomPoint();
+		positions.set( [ point.x, point.y + 0.5, point.z ], index * 3 );
+	}
+	const extents = new Float32Array( [ 2, 4, 2 ] );
+	const refs = new Uint32Array( count );
+	const points = new Float32Array( count * 3 );
+	const found = sample.findNearestPolyBatch( positions, extents, refs, points );
+	const previous = refs.slice();
+	const hinted = sample.findNearestPolyBatch( positions, extents, refs, points, true );
+	const kept = refs.every( ( ref, index ) => ref === previous[ index ] );
+	const single = sample.findNearestPoly( positions[ 0 ], positions[ 1 ], positions[ 2 ], 2, 4, 2 );
+	const blocked = new recast.QueryFilter();
+	blocked.setIncludeFlags( 0 );
+	const filtered = sample.findNearestPolyBatch( positions, extents, refs, points, blocked );
+	console.log( 'findNearestPolyBatch', found === count, hinted === count, kept, single.ref === previous[ 0 ], filtered === 0 );
+}
+
+if ( result ) {
+	const start = sample.findRandomPoint();
+	const end = sample.findRandomPoint();
+	const job = sample.createPathJob( start, end );
+	let steps = 0;
+	while ( job.step( 8 ) === recast.constants.DT_IN_PROGRESS ) {
+		steps++;
+	}
+	const path = job.finalize();
+	const last = sample.findStraightPath( start, end ).pop();
+	console.log( 'createPathJob', steps >= 0, path[ path.length - 1 ].ref === last.ref, job.step( 8 ) >= recast.constants.DT_FAILURE );
+}
+
+if ( result ) {
+	const queue = sample.createPathQueue( { aging: 0 } );
+	const start = sample.findRandomPoint();
+	const low = queue.request( start, sample.findRandomPoint(), 0 );
+	const high = queue.request( start, sample.findRandomPoint(), 5 );
+	const deduped = queue.request( start, sample.findRandomPoint(), 1, 'agent' );
+	const again = queue.request( start, sample.findRandomPoint(), 1, 'agent' );
+	const completed = [];
+	while ( completed.length < queue.size() ) {
+		completed.push( ...queue.update( 16, 1000 ) );
+	}
+	const path = queue.getResult( high );
+	console.log( 'createPathQueue', completed[ 0 ] === high && completed[ 2 ] === low, deduped === again, typeof path === 'object' && path.length > 0, queue.size() === 2 );
+}
+
+if ( result ) {
+	const swapped = new recast.NavQuery();
+	swapped.load( __dirname + '/tutorial.bin' );
+	const queue = swapped.createPathQueue();
+	const start = swapped.findRandomPoint();
+	const end = swapped.findRandomPoint();
+	const before = queue.request( start, end );
+	const stale = queue.request( start, end );
+	while ( queue.getStatus( stale ) & recast.constants.DT_IN_PROGRESS ) {
+		queue.update( 64 );
+	}
+	const found = queue.getResult( before );
+	swapped.load( __dirname + '/tutorial.bin' );
+	const status = queue.getResult( stale );
+	const after = queue.request( start, end );
+	while ( queue.getStatus( after ) & recast.constants.DT_IN_PROGRESS ) {
+		queue.update( 64 );
+	}
+	console.log( 'createPathQueue load', typeof found === 'object', typeof status === 'number' && ( status & recast.constants.DT_FAILURE ) !== 0, typeof queue.getResult( after ) === 'object' );
+}
+
+if ( result ) {
+	const blocked = new recast.QueryFilter();
+	blocked.setIncludeFlags( 0 );
+	blocked.freeze();
+	let frozen = false;
+	try {
+		blocked.setIncludeFlags( 0xffff );
+	} catch ( error ) {
+		frozen = blocked.isFrozen();
+	}
+	const walk = new recast.QueryFilter().freeze();
+	const start = sample.findRandomPoint();
+	const end = sample.findRandomPoint();
+	sample.findStraightPathAsync( start, end, walk ).then( path => {
+		console.log( 'QueryFilter', frozen, sample.findNearestPoly( start.x, start.y, start.z, 2, 4, 2, blocked ) === null, path.length === sample.findStraightPath( start, end, walk ).length );
+	} );
+}
+
+if ( result ) {
+	const cached = new recast.NavQuery( { pathCache: 16 } );
+	cached.load( __dirname + '/tutorial.bin' );
+	const start = cached.findRandomPoint();
+	const end = cached.findRandomPoint();
+	const first = cached.findStraightPath( start, end );
+	const second = cached.findStraightPath( start, end );
+	const hits = cached.getPathCacheStats().hits;
+	cached.setPolyFlags( start.ref, cached.getPolyFlags( start.ref ) );
+	cached.findStraightPath( start, end );
+	const stats = cached.getPathCacheStats();
+	console.log( 'pathCache', first.length === second.length, hits === 1, stats.invalidations === 1, stats.size === 1 );
+}
+
+if ( result ) {
+	const { Worker } = require( 'worker_threads' );
+	const handle = sample.share();
+	const start = sample.findRandomPoint();
+	const end = sample.findRandomPoint();
+	const local = new recast.NavQuery();
+	let rejected = false;
+	try {
+		local.attach( new SharedArrayBuffer( 8 ) );
+	} catch ( error ) {
+		rejected = true;
+	}
+	local.attach( handle );
+	const worker = new Worker( `
+		const { parentPort, workerData } = require( 'worker_threads' );
+		const query = new ( require( workerData.module ) ).NavQuery();
+		query.attach( workerData.handle );
+		parentPort.postMessage( query.findStraightPath( workerData.start, workerData.end ).length );
+	`, { eval: true, workerData: { module: require.resolve( '..' ), handle, start, end } } );
+	worker.once( 'message', length => {
+		console.log( 'worker', rejected, length === sample.findStraightPath( start, end ).length, length === local.findStraightPath( start, end ).length );
+	} );
+}
+
+if ( result ) {
+	const first = new recast.NavQuery( { seed: 42 } );
+	const second = new recast.NavQuery( { seed: 42 } );
+	first.load( __dirname + '/tutorial.bin' );
+	second.load( __dirname + '/tutorial.bin' );
+	const points = new Float32Array( 3 * 1000 );
+	const refs = new Uint32Array( 1000 );
+	const count = first.findRandomPoints( 1000, points, refs );
+	const again = new Float32Array( 3 * 1000 );
+	second.findRandomPoints( 1000, again );
+	const snapped = sample.findNearestPoly( points[ 0 ], points[ 1 ], points[ 2 ], 0.1, 1, 0.1 );
+	first.seed( 7 );
+	second.seed( 7 );
+	const a = first.findRandomPoint();
+	const b = second.findRandomPoint();
+	console.log( 'findRandomPoints', count === 1000, points.every( ( value, index ) => value === again[ index ] ), snapped !== null && snapped.ref === refs[ 0 ], a.ref === b.ref && a.x === b.x );
+}
+
+if ( result ) {
+	const center = sample.findRandomPoint();
+	const point = new Float32Array( 3 );
+	const ref = sample.findRandomPointAroundCircle( center, 10, point );
+	const refs = new Uint32Array( 64 );
+	const parents = new Uint32Array( 64 );
+	const costs = new Float32Array( 64 );
+	const count = sample.findPolysAroundCircle( center, 10, refs, parents, costs );
+	const capped = sample.findPolysAroundCircle( center, 1000, refs, 4 );
+	const local = sample.findLocalNeighbourhood( center, 10, refs, parents );
+	console.log( 'findPolysAroundCircle', ref > 0 && sample.getPolyFlags( ref ) >= 0, count > 0 && refs[ 0 ] === center.ref && parents[ 0 ] === 0 && costs[ 0 ] === 0, capped === 4, local > 0 && refs[ 0 ] === center.ref );
+}
+
+if ( result ) {
+	const measured = new recast.NavQuery( { stats: true, maxNodes: 32 } );
+	measured.load( __dirname + '/tutorial.bin' );
+	const start = measured.findRandomPoint();
+	const end = measured.findRandomPoint();
+	measured.findStraightPath( start, end );
+	measured.findStraightPath( end, start );
+	for ( let i = 0; i < 20; i++ ) {
+		measured.findStraightPath( measured.findRandomPoint(), measured.findRandomPoint() );
+	}
+	const stats = measured.getStats().findStraightPath;
+	const histogram = stats.histogram.reduce( ( sum, value ) => sum + value, 0 );
+	measured.resetStats();
+	console.log( 'stats', stats.count === 22 && histogram === 22, stats.nodes > 0 && stats.pushes > 0, stats.outOfNodes > 0, Object.keys( measured.getStats() ).length === 0 && sample.getStats() === null );
+}
+
+if ( result ) {
+	const hierarchical = new recast.NavQuery( { seed: 5 } );
+	hierarchical.load( __dirname + '/tutorial.bin' );
+	const graph = hierarchical.buildPortalGraph();
+	let same = 0;
+	let longest = 1;
+	for ( let i = 0; i < 200; i++ ) {
+		const start = hierarchical.findRandomPoint();
+		const end = hierarchical.findRandomPoint();
+		const flat = sample.findStraightPath( start, end );
+		const path = hierarchical.findStraightPath( start, end );
+		if ( path[ path.length - 1 ].ref === flat[ flat.length - 1 ].ref ) {
+			same++;
+		}
+		if ( pathLength( flat ) > 0 ) {
+			longest = Math.max( longest, pathLength( path ) / pathLength( flat ) );
+		}
+	}
+	console.log( 'buildPortalGraph', graph.nodes > 0 && graph.edges > 0, same === 200, longest < 1.05 );
+}
+
+if ( result ) {
+	const bidirectional = new recast.NavQuery( { seed: 9, bidirectional: true, stats: true } );
+	const flat = new recast.NavQuery( { stats: true } );
+	bidirectional.load( __dirname + '/tutorial.bin' );
+	flat.load( __dirname + '/tutorial.bin' );
+	// The tutorial mesh is small enough for a flat search to reach most of it,
+	// so compare both with the landmark bound, which keeps them off the far side.
+	const table = flat.buildLandmarks( 8 );
+	bidirectional.loadLandmarks( table );
+	flat.resetStats();
+	let same = 0;
+	let longest = 0;
+	let total = 0;
+	for ( let i = 0; i < 200; i++ ) {
+		const start = bidirectional.findRandomPoint();
+		const end = bidirectional.findRandomPoint();
+		const a = flat.findStraightPath( start, end );
+		const b = bidirectional.findStraightPath( start, end );
+		if ( b[ 0 ].ref === start.ref && sameEnd( a, b ) ) {
+			same++;
+		}
+		const ratio = pathLength( a ) > 0 ? pathLength( b ) / pathLength( a ) : 1;
+		longest = Math.max( longest, ratio );
+		total += ratio;
+	}
+	const stats = bidirectional.getStats().findStraightPath;
+	console.log( 'bidirectional', same === 200, stats.count === 200 && stats.nodes > 0, stats.nodes < flat.getStats().findStraightPath.nodes, longest < 1.05, Math.abs( total / 200 - 1 ) < 0.005 );
+}
+
+if ( result ) {
+	// The backward search has to step back across the one-way jumps of the
+	// maze and use the landmark bound in the right direction.
+	const bidirectional = new recast.NavQuery( { seed: 19, bidirectional: true } );
+	const flat = new recast.NavQuery();
+	bidirectional.load( __dirname + '/offmesh.bin' );
+	flat.load( __dirname + '/offmesh.bin' );
+	bidirectional.buildLandmarks( 8 );
+	let reached = 0;
+	let same = 0;
+	let flatLength = 0;
+	let bidirectionalLength = 0;
+	for ( let i = 0; i < 500; i++ ) {
+		const start = bidirectional.findRandomPoint();
+		const end = bidirectional.findRandomPoint();
+		const a = flat.findStraightPath( start, end );
+		const b = bidirectional.findStraightPath( start, end );
+		if ( sameEnd( b, [ end ] ) ) {
+			reached++;
+		}
+		if ( sameEnd( a, b ) ) {
+			same++;
+		}
+		flatLength += pathLength( a );
+		bidirectionalLength += pathLength( b );
+	}
+	console.log( 'bidirectional offmesh', reached === 500, same === 500, Math.abs( bidirectionalLength / flatLength - 1 ) < 0.01 );
+}
+
+if ( result ) {
+	const built = new recast.NavQuery( { seed: 11, stats: true } );
+	const loaded = new recast.NavQuery( { stats: true } );
+	built.load( __dirname + '/tutorial.bin' );
+	loaded.load( __dirname + '/tutorial.bin' );
+	const table = built.buildLandmarks( 8 );
+	const count = loaded.loadLandmarks( table );
+	let same = 0;
+	for ( let i = 0; i < 50; i++ ) {
+		const start = built.findRandomPoint();
+		const end = built.findRandomPoint();
+		const a = sample.findStraightPath( start, end );
+		const b = built.findStraightPath( start, end );
+		const c = loaded.findStraightPath( start, end );
+		if ( b[ b.length - 1 ].ref === a[ a.length - 1 ].ref && JSON.stringify( b ) === JSON.stringify( c ) ) {
+			same++;
+		}
+	}
+	let rejected = false;
+	try {
+		loaded.loadLandmarks( new Uint8Array( 64 ) );
+	} catch ( e ) {
+		rejected = true;
+	}
+	console.log( 'buildLandmarks', table.length > 0 && count === 8, same === 50, built.getStats().findStraightPath.nodes === loaded.getStats().findStraightPath.nodes, rejected );
+}
+
+if ( result ) {
+	// A generated maze with off-mesh jumps over some of its walls, most of
+	// them one-way.
+	const flat = new recast.NavQuery( { seed: 13, stats: true } );
+	const landmarks = new recast.NavQuery( { stats: true } );
+	flat.load( __dirname + '/offmesh.bin' );
+	landmarks.load( __dirname + '/offmesh.bin' );
+	landmarks.buildLandmarks( 8 );
+	landmarks.resetStats();
+	let same = 0;
+	let jumps = 0;
+	let flatLength = 0;
+	let landmarksLength = 0;
+	let longest = 0;
+	for ( let i = 0; i < 200; i++ ) {
+		const start = flat.findRandomPoint();
+		const end = flat.findRandomPoint();
+		const a = flat.findStraightPath( start, end );
+		const b = landmarks.findStraightPath( start, end );
+		if ( b[ b.length - 1 ].ref === a[ a.length - 1 ].ref ) {
+			same++;
+		}
+		if ( a.some( ( point ) => point.flags & recast.constants.DT_STRAIGHTPATH_OFFMESH_CONNECTION ) ) {
+			jumps++;
+		}
+		flatLength += pathLength( a );
+		landmarksLength += pathLength( b );
+		longest = Math.max( longest, pathLength( a ) > 0 ? pathLength( b ) / pathLength( a ) : 1 );
+	}
+	console.log( 'buildLandmarks offmesh', same === 200, jumps > 0, landmarks.getStats().findStraightPath.nodes < flat.getStats().findStraightPath.nodes, Math.abs( landmarksLength / flatLength - 1 ) < 0.005, longest < 1.1 );
+}
+
+if ( result ) {
+	const quaternary = new recast.NavQuery( { seed: 13, openList: 'quaternary', stats: true } );
+	quaternary.load( __dirname + '/tutorial.bin' );
+	let same = 0;
+	for ( let i = 0; i < 50; i++ ) {
+		const start = quaternary.findRandomPoint();
+		const end = quaternary.findRandomPoint();
+		const a = sample.findStraightPath( start, end );
+		const b = quaternary.findStraightPath( start, end );
+		if ( b.length === a.length && b[ b.length - 1 ].ref === a[ a.length - 1 ].ref ) {
+			same++;
+		}
+	}
+	let rejected = false;
+	try {
+		new recast.NavQuery( { openList: 'radix' } );
+	} catch ( e ) {
+		rejected = e instanceof RangeError;
+	}
+	console.log( 'openList', same === 50, quaternary.getStats().findStraightPath.nodes > 0, rejected );
+}
+
+if ( result ) {
+	const large = new recast.NavQuery( { seed: 17, maxNodes: 100000, bidirectional: true } );
+	large.load( __dirname + '/tutorial.bin' );
+	let same = 0;
+	for ( let i = 0; i < 50; i++ ) {
+		const start = large.findRandomPoint();
+		const end = large.findRandomPoint();
+		const a = sample.findStraightPath( start, end );
+		const b = large.findStraightPath( start, end );
+		if ( b[ b.length - 1 ].ref === a[ a.length - 1 ].ref ) {
+			same++;
+		}
+	}
+	let rejected = false;
+	try {
+		new recast.NavQuery( { maxNodes: 16777216 } );
+	} catch ( e ) {
+		rejected = e instanceof RangeError;
+	}
+	console.log( 'maxNodes', same === 50, rejected );
+}